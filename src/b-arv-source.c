@@ -103,7 +103,8 @@ void frame_ready(ArvStream *stream, gpointer user_data) {
         image->data[i]=(guint16) b[i];
       }
       image->frame->num = arv_buffer_get_frame_id(buffer);
-      image->timestamp = arv_buffer_get_timestamp(buffer);
+      /* host time, so frames line up with other records */
+      image->timestamp = arv_buffer_get_system_timestamp(buffer);
       g_mutex_unlock(&image->dmut);
       g_idle_add(emit_changed,image);
     }
@@ -0,0 +1,389 @@
+/*
+ * b-bin-operation.c :
+ *
+ * Copyright (C) 2017 Scott O. Johnson (scojo202@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <memory.h>
+#include <math.h>
+#include "b-bin-operation.h"
+#include "data/b-struct.h"
+#ifdef ARAVIS
+#include "b-arv-source.h"
+#endif
+
+/**
+ * SECTION: b-bin-operation
+ * @short_description: Operation that bins a matrix or vector into blocks.
+ *
+ * This operation adds up (or averages) blocks of bin2 rows by bin1 columns
+ * of a matrix, or runs of bin1 elements of a vector, giving a smaller array.
+ * Rows and columns left over at the end that don't fill a whole block are
+ * dropped.
+ *
+ * 2x2 and 4x4 blocks have their own loops, which compilers vectorize. Input
+ * from a #BArvSource is kept as 16 bit integers in the task data, and
+ * converted to double a few rows at a time while binning.
+ */
+
+enum {
+  BIN_PROP_0,
+  BIN_PROP_BIN1,
+  BIN_PROP_BIN2,
+  BIN_PROP_MEAN
+};
+
+/* smallest number of input elements worth binning on a separate thread */
+#define BIN_MIN_JOB_SAMPLES 262144
+
+struct _BBinOperation {
+  BOperation base;
+  int bin1;
+  int bin2;
+  gboolean mean;
+};
+
+G_DEFINE_TYPE(BBinOperation, b_bin_operation, B_TYPE_OPERATION);
+
+static void
+bin_operation_set_property(GObject * gobject, guint param_id,
+                           GValue const *value, GParamSpec * pspec)
+{
+  BBinOperation *sop = B_BIN_OPERATION(gobject);
+
+  switch (param_id) {
+  case BIN_PROP_BIN1:
+    sop->bin1 = g_value_get_int(value);
+    break;
+  case BIN_PROP_BIN2:
+    sop->bin2 = g_value_get_int(value);
+    break;
+  case BIN_PROP_MEAN:
+    sop->mean = g_value_get_boolean(value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
+    return;		/* NOTE : RETURN */
+  }
+}
+
+static void
+bin_operation_get_property(GObject * gobject, guint param_id,
+                           GValue * value, GParamSpec * pspec)
+{
+  BBinOperation *sop = B_BIN_OPERATION(gobject);
+
+  switch (param_id) {
+  case BIN_PROP_BIN1:
+    g_value_set_int(value, sop->bin1);
+    break;
+  case BIN_PROP_BIN2:
+    g_value_set_int(value, sop->bin2);
+    break;
+  case BIN_PROP_MEAN:
+    g_value_set_boolean(value, sop->mean);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
+    return;		/* NOTE : RETURN */
+  }
+}
+
+/* size of the input as a matrix; a vector is a single row */
+static
+BMatrixSize bin_input_size(BData * input, gboolean * is_vector)
+{
+  BMatrixSize size = { 0, 0 };
+  *is_vector = FALSE;
+#ifdef ARAVIS
+  if (B_IS_ARV_SOURCE(input))
+    return b_arv_source_get_size(B_ARV_SOURCE(input));
+#endif
+  if (B_IS_VECTOR(input)) {
+    *is_vector = TRUE;
+    size.rows = 1;
+    size.columns = b_vector_get_len(B_VECTOR(input));
+  } else if (B_IS_MATRIX(input)) {
+    size = b_matrix_get_size(B_MATRIX(input));
+  }
+  return size;
+}
+
+static
+int bin_size(BOperation * op, BData * input, unsigned int *dims)
+{
+  g_return_val_if_fail(B_IS_DATA(input),0);
+  g_assert(dims);
+  BBinOperation *sop = B_BIN_OPERATION(op);
+
+  g_assert(!B_IS_SCALAR(input));
+  g_assert(!B_IS_STRUCT(input));
+
+  gboolean is_vector;
+  BMatrixSize size = bin_input_size(input, &is_vector);
+  if (is_vector) {
+    dims[0] = size.columns / sop->bin1;
+    return 1;
+  }
+  dims[0] = size.rows / sop->bin2;
+  dims[1] = size.columns / sop->bin1;
+  return 2;
+}
+
+typedef struct {
+  BBinOperation sop;
+  gboolean is_vector;
+  BMatrixSize size;		/* size of the input */
+  double *input;
+  guint16 *input16;		/* used instead of input for 16 bit data */
+  unsigned int input_len;
+  BMatrixSize output_size;
+  double *output;
+  unsigned int output_len;
+  unsigned int n_jobs;
+  double *rows;			/* bin2 converted rows per job, for input16 */
+  unsigned int rows_len;
+} BinOpData;
+
+static
+gpointer bin_op_create_data(BOperation * op, gpointer data, BData * input)
+{
+  if (input == NULL)
+    return NULL;
+  BinOpData *d;
+  if (data == NULL) {
+    d = g_new0(BinOpData, 1);
+  } else {
+    d = (BinOpData *) data;
+  }
+  BBinOperation *sop = B_BIN_OPERATION(op);
+  d->sop = *sop;
+  d->size = bin_input_size(input, &d->is_vector);
+  if (d->is_vector)
+    d->sop.bin2 = 1;
+  unsigned int len = d->size.rows * d->size.columns;
+
+#ifdef ARAVIS
+  if (B_IS_ARV_SOURCE(input)) {
+    g_clear_pointer(&d->input,g_free);
+    g_free(d->input16);
+    d->input16 = b_arv_source_get_values(B_ARV_SOURCE(input));
+    d->input_len = d->input16 ? len : 0;
+  } else
+#endif
+  {
+    g_clear_pointer(&d->input16,g_free);
+    if (d->is_vector) {
+      d->input = b_create_input_array_from_vector_range(B_VECTOR(input), 0,
+                                                        len, d->input_len,
+                                                        d->input);
+    } else {
+      d->input = b_create_input_array_from_matrix_region(B_MATRIX(input), 0,
+                                                         0, d->size,
+                                                         d->input_len,
+                                                         d->input);
+    }
+    d->input_len = d->input ? len : 0;
+  }
+  if (d->input_len == 0) {
+    d->size.rows = 0;
+    d->size.columns = 0;
+  }
+
+  d->output_size.rows = d->size.rows / d->sop.bin2;
+  d->output_size.columns = d->size.columns / d->sop.bin1;
+  unsigned int out_len = d->output_size.rows * d->output_size.columns;
+  if (d->output_len != out_len || d->output == NULL) {
+    g_clear_pointer(&d->output,g_free);
+    d->output = g_try_new0(double, MAX(out_len, 1));
+    d->output_len = d->output ? out_len : 0;
+  }
+
+  d->n_jobs = b_operation_get_n_jobs(d->input_len, BIN_MIN_JOB_SAMPLES);
+  d->n_jobs = MIN(d->n_jobs, MAX(d->output_size.rows, 1));
+  if (d->input16) {
+    unsigned int rows_len = d->n_jobs * d->sop.bin2 * d->size.columns;
+    if (d->rows_len != rows_len || d->rows == NULL) {
+      g_clear_pointer(&d->rows,g_free);
+      d->rows = g_try_new(double, MAX(rows_len, 1));
+      d->rows_len = d->rows ? rows_len : 0;
+    }
+  } else {
+    g_clear_pointer(&d->rows,g_free);
+    d->rows_len = 0;
+  }
+  return d;
+}
+
+static
+void bin_op_data_free(gpointer data)
+{
+  BinOpData *d = (BinOpData *) data;
+  g_clear_pointer(&d->input,g_free);
+  g_clear_pointer(&d->input16,g_free);
+  g_clear_pointer(&d->output,g_free);
+  g_clear_pointer(&d->rows,g_free);
+  g_free(d);
+}
+
+/* bin n input rows into one output row of ncol elements */
+static
+void bin_rows(const double **r, unsigned int bin1, unsigned int bin2,
+              unsigned int ncol, double *restrict o)
+{
+  unsigned int j, k, b;
+  if (bin1 == 2 && bin2 == 2) {
+    const double *restrict r0 = r[0], *restrict r1 = r[1];
+    for (j = 0; j < ncol; j++)
+      o[j] = (r0[2 * j] + r0[2 * j + 1]) + (r1[2 * j] + r1[2 * j + 1]);
+  } else if (bin1 == 4 && bin2 == 4) {
+    const double *restrict r0 = r[0], *restrict r1 = r[1];
+    const double *restrict r2 = r[2], *restrict r3 = r[3];
+    for (j = 0; j < ncol; j++) {
+      const size_t c = 4 * (size_t) j;
+      double s0 = (r0[c] + r0[c + 1]) + (r0[c + 2] + r0[c + 3]);
+      double s1 = (r1[c] + r1[c + 1]) + (r1[c + 2] + r1[c + 3]);
+      double s2 = (r2[c] + r2[c + 1]) + (r2[c + 2] + r2[c + 3]);
+      double s3 = (r3[c] + r3[c + 1]) + (r3[c + 2] + r3[c + 3]);
+      o[j] = (s0 + s1) + (s2 + s3);
+    }
+  } else {
+    memset(o, 0, ncol * sizeof(double));
+    for (k = 0; k < bin2; k++) {
+      const double *restrict x = r[k];
+      for (j = 0; j < ncol; j++) {
+        double s = 0.0;
+        for (b = 0; b < bin1; b++)
+          s += x[(size_t) j * bin1 + b];
+        o[j] += s;
+      }
+    }
+  }
+}
+
+static
+void bin_job(unsigned int job, gpointer data)
+{
+  BinOpData *d = (BinOpData *) data;
+  unsigned int bin1 = d->sop.bin1;
+  unsigned int bin2 = d->sop.bin2;
+  unsigned int ncol_in = d->size.columns;
+  unsigned int ncol = d->output_size.columns;
+  unsigned int nrow = d->output_size.rows;
+  unsigned int first = (unsigned int) (((size_t) nrow * job) / d->n_jobs);
+  unsigned int last = (unsigned int) (((size_t) nrow * (job + 1)) / d->n_jobs);
+  double scale = d->sop.mean ? 1.0 / (bin1 * bin2) : 1.0;
+  const double *stack_rows[16];
+  const double **r = (bin2 <= 16) ? stack_rows : g_new(const double *, bin2);
+  unsigned int i, j, k;
+
+  for (i = first; i < last; i++) {
+    for (k = 0; k < bin2; k++) {
+      size_t row = (size_t) i * bin2 + k;
+      if (d->input16) {
+        /* convert this block's rows of 16 bit data to double */
+        double *x = d->rows + ((size_t) job * bin2 + k) * ncol_in;
+        const guint16 *restrict y = d->input16 + row * ncol_in;
+        for (j = 0; j < ncol_in; j++)
+          x[j] = y[j];
+        r[k] = x;
+      } else {
+        r[k] = d->input + row * ncol_in;
+      }
+    }
+    double *o = d->output + (size_t) i * ncol;
+    bin_rows(r, bin1, bin2, ncol, o);
+    if (scale != 1.0) {
+      for (j = 0; j < ncol; j++)
+        o[j] *= scale;
+    }
+  }
+  if (r != stack_rows)
+    g_free(r);
+}
+
+static
+gpointer bin_op(gpointer data)
+{
+  BinOpData *d = (BinOpData *) data;
+
+  if (d == NULL || d->output == NULL)
+    return NULL;
+  if (d->input16 && d->rows == NULL)
+    return NULL;
+
+  b_operation_run_parallel(d->n_jobs, bin_job, d);
+  return d->output;
+}
+
+static void b_bin_operation_class_init(BBinOperationClass * klass)
+{
+  GObjectClass *gobject_klass = (GObjectClass *) klass;
+  gobject_klass->set_property = bin_operation_set_property;
+  gobject_klass->get_property = bin_operation_get_property;
+  BOperationClass *op_klass = (BOperationClass *) klass;
+  op_klass->thread_safe = TRUE;
+  op_klass->op_size = bin_size;
+  op_klass->op_func = bin_op;
+  op_klass->op_data = bin_op_create_data;
+  op_klass->op_data_free = bin_op_data_free;
+
+  g_object_class_install_property(gobject_klass, BIN_PROP_BIN1,
+      g_param_spec_int("bin1", "Bin size #1",
+                       "Number of columns (or vector elements) in each block",
+                       1, 2000000000, 2,
+                       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, BIN_PROP_BIN2,
+      g_param_spec_int("bin2", "Bin size #2",
+                       "Number of rows in each block",
+                       1, 2000000000, 2,
+                       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, BIN_PROP_MEAN,
+      g_param_spec_boolean("mean", "average over elements",
+                      "Average over elements if TRUE, sum over them if FALSE.",
+                      FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void b_bin_operation_init(BBinOperation * op)
+{
+  op->bin1 = 2;
+  op->bin2 = 2;
+}
+
+/**
+ * b_bin_operation_new:
+ * @bin1: number of columns in each block
+ * @bin2: number of rows in each block
+ * @mean: whether to average rather than sum each block
+ *
+ * Create a new binning operation.
+ *
+ * Returns: a #BOperation
+ **/
+BOperation *b_bin_operation_new(int bin1, int bin2, gboolean mean)
+{
+  g_return_val_if_fail(bin1 >= 1, NULL);
+  g_return_val_if_fail(bin2 >= 1, NULL);
+
+  BOperation *o = g_object_new(B_TYPE_BIN_OPERATION, "bin1", bin1,
+                               "bin2", bin2, "mean", mean, NULL);
+
+  return o;
+}
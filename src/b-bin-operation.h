@@ -0,0 +1,35 @@
+/*
+ * b-bin-operation.h :
+ *
+ * Copyright (C) 2017 Scott O. Johnson (scojo202@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <data/b-data-class.h>
+#include <b-operation.h>
+
+G_BEGIN_DECLS
+
+G_DECLARE_FINAL_TYPE(BBinOperation,b_bin_operation,B,BIN_OPERATION,BOperation)
+
+#define B_TYPE_BIN_OPERATION  (b_bin_operation_get_type ())
+
+BOperation *b_bin_operation_new (int bin1, int bin2, gboolean mean);
+
+G_END_DECLS
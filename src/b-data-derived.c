@@ -22,6 +22,8 @@
 #include <memory.h>
 #include <math.h>
 #include "b-data-derived.h"
+#include "b-slice-operation.h"
+#include "data/b-struct.h"
 
 /**
  * SECTION: b-data-derived
@@ -71,6 +73,7 @@ typedef struct {
   gulong handler;
   unsigned int autorun : 1;
   unsigned int running : 1;	/* is operation currently running? */
+  unsigned int input_dirty : 1;	/* has input changed since task data was updated? */
   gpointer task_data;
 } Derived;
 
@@ -120,9 +123,23 @@ static void derived_set_input(Derived *d, BData *new_d)
     g_clear_object(&d->input);
     d->input = new_d;
     g_object_ref_sink(d->input);
+    d->input_dirty = TRUE;
   }
 }
 
+/* bring the task data up to date before calling op_func, copying the input
+   only if it has changed since the last update */
+static void derived_update_task_data(Derived *d)
+{
+  if (d->task_data == NULL) {
+    d->task_data = b_operation_create_task_data(d->op, d->input);
+  } else if (d->input_dirty ||
+             !b_operation_update_task_pars(d->op, d->task_data)) {
+    b_operation_update_task_data(d->op, d->task_data, d->input);
+  }
+  d->input_dirty = FALSE;
+}
+
 /*****************/
 
 struct _BDerivedScalar {
@@ -158,13 +175,7 @@ static double scalar_derived_get_value(BScalar * sca)
   g_return_val_if_fail(klass->op_size(scas->der.op,scas->der.input, dims)==0,NAN);
 
   /* call op */
-  if (scas->der.task_data == NULL) {
-    scas->der.task_data =
-      b_operation_create_task_data(scas->der.op, scas->der.input);
-  } else {
-    b_operation_update_task_data(scas->der.op, scas->der.task_data,
-                                  scas->der.input);
-  }
+  derived_update_task_data(&scas->der);
   double *dout = klass->op_func(scas->der.task_data);
 
   return *dout;
@@ -186,6 +197,7 @@ static void scalar_on_input_changed(BData * data, gpointer user_data)
   g_return_if_fail(B_IS_DATA(data));
   g_return_if_fail(B_IS_DERIVED_SCALAR(user_data));
   BDerivedScalar *d = B_DERIVED_SCALAR(user_data);
+  d->der.input_dirty = TRUE;
   if (!d->der.autorun) {
     b_data_emit_changed(B_DATA(d));
   } else {
@@ -196,6 +208,7 @@ static void scalar_on_input_changed(BData * data, gpointer user_data)
     if (klass->thread_safe) {
       /* get task data, run in a thread */
       b_operation_update_task_data(d->der.op, d->der.task_data, data);
+      d->der.input_dirty = FALSE;
       b_operation_run_task(d->der.op, d->der.task_data, scalar_op_cb, d);
     } else {
       /* load new values into the cache */
@@ -378,13 +391,7 @@ static double *vector_derived_load_values(BVector * vec)
 
   /* call op */
   BOperationClass *klass = B_OPERATION_GET_CLASS(vecs->der.op);
-  if (vecs->der.task_data == NULL) {
-    vecs->der.task_data =
-      b_operation_create_task_data(vecs->der.op, vecs->der.input);
-  } else {
-    b_operation_update_task_data(vecs->der.op, vecs->der.task_data,
-                                 vecs->der.input);
-  }
+  derived_update_task_data(&vecs->der);
   double *dout = klass->op_func(vecs->der.task_data);
   g_return_val_if_fail (dout != NULL, NULL);
   memcpy(v, dout, len * sizeof(double));
@@ -418,6 +425,7 @@ static void on_input_changed_after(BData * data, gpointer user_data)
   /* if shape changed, adjust length */
   /* FIXME: this just loads the length every time */
   vector_derived_load_len(B_VECTOR(d));
+  d->der.input_dirty = TRUE;
   if (!d->der.autorun) {
     b_data_emit_changed(B_DATA(d));
   } else {
@@ -428,6 +436,7 @@ static void on_input_changed_after(BData * data, gpointer user_data)
     if (klass->thread_safe) {
       /* get task data, run in a thread */
       b_operation_update_task_data(d->der.op, d->der.task_data, data);
+      d->der.input_dirty = FALSE;
       b_operation_run_task(d->der.op, d->der.task_data, op_cb, d);
     } else {
       /* load new values into the cache */
@@ -613,13 +622,7 @@ static double *derived_matrix_load_values(BMatrix * vec)
 
   /* call op */
   BOperationClass *klass = B_OPERATION_GET_CLASS(vecs->der.op);
-  if (vecs->der.task_data == NULL) {
-    vecs->der.task_data =
-      b_operation_create_task_data(vecs->der.op, vecs->der.input);
-    } else {
-    b_operation_update_task_data(vecs->der.op, vecs->der.task_data,
-                                 vecs->der.input);
-  }
+  derived_update_task_data(&vecs->der);
   double *dout = klass->op_func(vecs->der.task_data);
   g_return_val_if_fail(dout!=NULL,NULL);
   memcpy(v, dout, size.rows * size.columns * sizeof(double));
@@ -654,6 +657,7 @@ static void on_input_changed_after2(BData * data, gpointer user_data)
   /* if shape changed, adjust length */
   /* FIXME: this just loads the length every time */
   derived_matrix_load_size(B_MATRIX(d));
+  d->der.input_dirty = TRUE;
   if (!d->der.autorun) {
     b_data_emit_changed(B_DATA(d));
   } else {
@@ -664,6 +668,7 @@ static void on_input_changed_after2(BData * data, gpointer user_data)
     if (klass->thread_safe) {
       /* get task data, run in a thread */
       b_operation_update_task_data(d->der.op, d->der.task_data, data);
+      d->der.input_dirty = FALSE;
       b_operation_run_task(d->der.op, d->der.task_data, op_cb2, d);
     } else {
       /* load new values into the cache */
@@ -777,3 +782,39 @@ BData *b_derived_matrix_new(BData * input, BOperation * op)
   }
   return d;
 }
+
+/****************************************************************************/
+
+/**
+ * b_derived_struct_new:
+ * @input: an input array
+ * @op: an operation with matrix output
+ * @names: (array zero-terminated=1): %NULL-terminated names for the rows of
+ *   the output of @op
+ *
+ * Create a #BStruct holding one vector for each row of the output of @op,
+ * stored under the corresponding name in @names. The operation is run once
+ * for each change of @input, no matter how many of the vectors are used.
+ *
+ * Returns: (transfer full): a #BStruct
+ **/
+BData *b_derived_struct_new(BData * input, BOperation * op,
+                            const gchar ** names)
+{
+  g_return_val_if_fail(B_IS_DATA(input), NULL);
+  g_return_val_if_fail(B_IS_OPERATION(op), NULL);
+  g_return_val_if_fail(names != NULL, NULL);
+
+  BData *mat = b_derived_matrix_new(input, op);
+  g_object_ref_sink(mat);
+  BStruct *s = g_object_new(B_TYPE_STRUCT, NULL);
+  unsigned int i;
+  for (i = 0; names[i] != NULL; i++) {
+    BOperation *row = b_slice_operation_new(SLICE_ROW, i, 1);
+    BData *v = b_derived_vector_new(mat, row);
+    g_object_unref(row);
+    b_struct_set_data(s, names[i], v);
+  }
+  g_object_unref(mat);
+  return B_DATA(s);
+}
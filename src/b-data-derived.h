@@ -55,4 +55,6 @@ G_DECLARE_FINAL_TYPE(BDerivedMatrix,b_derived_matrix,B,DERIVED_MATRIX,BMatrix)
 
 BData	*b_derived_matrix_new      (BData *input, BOperation *op);
 
+BData	*b_derived_struct_new      (BData *input, BOperation *op, const gchar **names);
+
 G_END_DECLS
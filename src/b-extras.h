@@ -24,9 +24,15 @@
 #include <b-data-derived.h>
 #include <b-operation.h>
 #include <b-hdf.h>
+#include <b-hdf-data.h>
 #include <b-simple-operation.h>
 #include <b-subset-operation.h>
+#include <b-bin-operation.h>
+#include <b-transpose-operation.h>
 #include <b-slice-operation.h>
+#include <b-line-profile-operation.h>
+#include <b-stats-operation.h>
+#include <b-region-operation.h>
 #include <b-scalar-property.h>
 #include <b-fft-operation.h>
 #include <b-image.h>
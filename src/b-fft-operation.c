@@ -26,6 +26,8 @@
 #include <fftw3.h>
 #endif
 #include "b-fft-operation.h"
+#include "b-data-derived.h"
+#include <data/b-data-simple.h>
 
 /**
  * SECTION: b-fft-operation
@@ -33,17 +35,44 @@
  *
  * These operations take the Fourier transform of the input and output the magnitude and phase of the spectrum.
  *
+ * Setting the "components" property of #BFFTOperation makes it output a
+ * matrix with one row for each of several components (magnitude, phase,
+ * real and imaginary parts, power) computed from a single transform;
+ * b_fft_struct_new() wraps these rows in a #BStruct of vectors.
+ *
+ * Setting the "single-precision" property makes #BFFTOperation transform a
+ * float copy of the input with a single precision plan, which halves the
+ * memory used and is faster where double precision isn't needed, e.g. for
+ * display.
+ *
+ * #BSpectrogramOperation takes the short-time Fourier transform of a vector,
+ * producing a matrix with one row per time segment and one column per
+ * frequency.
+ *
+ * #BConvolutionOperation convolves a vector with a fixed kernel, or
+ * correlates it with itself or with a second vector, by multiplying spectra.
+ * Long inputs are convolved with a short kernel block by block
+ * (overlap-add), so the cost grows linearly with the input length.
+ *
+ * #BFFTStream is a vector holding the spectrum of the most recent frame of a
+ * stream of samples. It transforms each frame of samples once, as soon as it
+ * is complete, rather than the whole history of the input.
+ *
  *
  */
 
 enum {
   FFT_PROP_0,
-  FFT_PROP_TYPE
+  FFT_PROP_TYPE,
+  FFT_PROP_SINGLE,
+  FFT_PROP_COMPONENTS
 };
 
 struct _BFFTOperation {
   BOperation base;
   guchar type;
+  gboolean single;
+  guint components;
 };
 
 G_DEFINE_TYPE(BFFTOperation, b_fft_operation, B_TYPE_OPERATION);
@@ -58,6 +87,12 @@ fft_operation_set_property(GObject * gobject, guint param_id,
   case FFT_PROP_TYPE:
     sop->type = g_value_get_int(value);
     break;
+  case FFT_PROP_SINGLE:
+    sop->single = g_value_get_boolean(value);
+    break;
+  case FFT_PROP_COMPONENTS:
+    sop->components = g_value_get_uint(value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
     return;
@@ -74,22 +109,47 @@ fft_operation_get_property(GObject * gobject, guint param_id,
   case FFT_PROP_TYPE:
     g_value_set_int(value, sop->type);
     break;
-
+  case FFT_PROP_SINGLE:
+    g_value_set_boolean(value, sop->single);
+    break;
+  case FFT_PROP_COMPONENTS:
+    g_value_set_uint(value, sop->components);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
     return;		/* NOTE : RETURN */
   }
 }
 
+static
+unsigned int fft_n_components(guint components)
+{
+  unsigned int n = 0;
+  int type;
+  for (type = FFT_MAG; type <= FFT_POWER; type++) {
+    if (components & FFT_COMPONENT(type))
+      n++;
+  }
+  return n;
+}
+
 static
 int vector_fft_size(BOperation * op, BData * input, unsigned int *dims)
 {
   int n_dims;
   g_assert(B_IS_VECTOR(input));
   g_assert(dims);
+  BFFTOperation *sop = B_FFT_OPERATION(op);
   BVector *mat = B_VECTOR(input);
-  dims[0] = b_vector_get_len(mat) / 2 + 1;
-  n_dims = 1;
+  if (sop->components != 0) {
+    /* one row per component */
+    dims[0] = fft_n_components(sop->components);
+    dims[1] = b_vector_get_len(mat) / 2 + 1;
+    n_dims = 2;
+  } else {
+    dims[0] = b_vector_get_len(mat) / 2 + 1;
+    n_dims = 1;
+  }
   return n_dims;
 }
 
@@ -100,9 +160,27 @@ typedef struct {
   fftw_complex *inter;
   double *output;
   unsigned int out_len;
+  unsigned int n_comp;
   fftw_plan plan;
+  /* single precision buffers and plan, used instead of the above if set */
+  gboolean single;
+  float *finput;
+  fftwf_complex *finter;
+  fftwf_plan fplan;
 } FFTOpData;
 
+static
+void vector_fft_op_data_clear(FFTOpData * d)
+{
+  g_clear_pointer(&d->input, fftw_free);
+  g_clear_pointer(&d->inter, fftw_free);
+  g_clear_pointer(&d->plan, fftw_destroy_plan);
+  g_clear_pointer(&d->finput, fftwf_free);
+  g_clear_pointer(&d->finter, fftwf_free);
+  g_clear_pointer(&d->fplan, fftwf_destroy_plan);
+  g_clear_pointer(&d->output, g_free);
+}
+
 static
 gpointer vector_fft_op_create_data(BOperation * op, gpointer data,
                                    BData * input)
@@ -110,62 +188,133 @@ gpointer vector_fft_op_create_data(BOperation * op, gpointer data,
   if (input == NULL)
     return NULL;
   FFTOpData *d;
-  gboolean neu = TRUE;
-  gboolean size_changed = FALSE;
   if (data == NULL) {
     d = g_new0(FFTOpData, 1);
   } else {
-    neu = FALSE;
     d = (FFTOpData *) data;
   }
   BFFTOperation *sop = B_FFT_OPERATION(op);
   d->sop = *sop;
   BVector *vec = B_VECTOR(input);
-  unsigned int old_len = d->len;
-  d->input = b_create_input_array_from_vector(vec, neu, d->len, d->input);
-  d->len = b_vector_get_len(vec);
-  if (d->len == 0)
+  unsigned int len = b_vector_get_len(vec);
+  if (len == 0)
     return NULL;
-  if (!neu) {
-    if (old_len != d->len) {
-      size_changed = TRUE;
+  unsigned int n_comp = MAX(fft_n_components(sop->components), 1);
+  if (len != d->len || sop->single != d->single || n_comp != d->n_comp
+      || d->output == NULL) {
+    vector_fft_op_data_clear(d);
+    d->len = len;
+    d->out_len = len / 2 + 1;
+    d->n_comp = n_comp;
+    d->single = sop->single;
+    d->output = g_new0(double, d->out_len * d->n_comp);
+    if (d->single) {
+      d->finput = fftwf_malloc(sizeof(float) * d->len);
+      d->finter = fftwf_malloc(sizeof(fftwf_complex) * d->out_len);
+      d->fplan = fftwf_plan_dft_r2c_1d(d->len, d->finput, d->finter,
+                                       FFTW_ESTIMATE);
+    } else {
+      d->input = fftw_malloc(sizeof(double) * d->len);
+      d->inter = fftw_malloc(sizeof(fftw_complex) * d->out_len);
+      d->plan = fftw_plan_dft_r2c_1d(d->len, d->input, d->inter,
+                                     FFTW_ESTIMATE);
     }
   }
-  unsigned int dims[1];
-  vector_fft_size(op, input, dims);
-  if (d->out_len != dims[0]) {
-    size_changed = TRUE;
-    if (d->inter)
-      fftw_free(d->inter);
-    if (d->output)
-      g_free(d->output);
-    d->out_len = dims[0];
-    d->inter = fftw_malloc(sizeof(fftw_complex) * d->out_len);
-    memset(d->inter, 0, sizeof(fftw_complex) * d->out_len);
-    d->output = g_new0(double, d->out_len);
-  }
-  g_assert(d->input);
-  g_assert(d->inter);
-  g_assert(d->len > 0);
-  if (neu || size_changed) {
-    d->plan = fftw_plan_dft_r2c_1d(d->len, d->input, d->inter, FFTW_ESTIMATE);
-  }
-  memset(d->inter, 0, sizeof(fftw_complex) * d->out_len);
-  memcpy(d->input, b_vector_get_values(vec), d->len * sizeof(double));
+  const double *v = b_vector_get_values(vec);
+  if (d->single) {
+    unsigned int i;
+    for (i = 0; i < d->len; i++) {
+      d->finput[i] = (float) v[i];
+    }
+  } else {
+    memcpy(d->input, v, d->len * sizeof(double));
+  }
   return d;
 }
 
 static
 void vector_fft_op_data_free(gpointer d)
 {
-  FFTOpData *s = (FFTOpData *) d;
-  fftw_free(s->input);
-  fftw_free(s->inter);
-  fftw_destroy_plan(s->plan);
-  g_free(s->output);
+  vector_fft_op_data_clear((FFTOpData *) d);
   g_free(d);
 }
 
+static
+void fft_component(const fftw_complex * inter, double *output,
+                   unsigned int n, int type)
+{
+  unsigned int i;
+  switch (type) {
+  case FFT_MAG:
+    for (i = 0; i < n; i++) {
+      complex double ci = (complex double)inter[i];
+      output[i] = cabs(ci);
+    }
+    break;
+  case FFT_PHASE:
+    for (i = 0; i < n; i++) {
+      complex double ci = (complex double)inter[i];
+      output[i] = carg(ci);
+    }
+    break;
+  case FFT_REAL:
+    for (i = 0; i < n; i++) {
+      output[i] = creal(inter[i]);
+    }
+    break;
+  case FFT_IMAG:
+    for (i = 0; i < n; i++) {
+      output[i] = cimag(inter[i]);
+    }
+    break;
+  case FFT_POWER:
+    for (i = 0; i < n; i++) {
+      double re = creal(inter[i]);
+      double im = cimag(inter[i]);
+      output[i] = re * re + im * im;
+    }
+    break;
+  }
+}
+
+static
+void fft_component_single(const fftwf_complex * inter, double *output,
+                          unsigned int n, int type)
+{
+  unsigned int i;
+  switch (type) {
+  case FFT_MAG:
+    for (i = 0; i < n; i++) {
+      complex float ci = (complex float)inter[i];
+      output[i] = cabsf(ci);
+    }
+    break;
+  case FFT_PHASE:
+    for (i = 0; i < n; i++) {
+      complex float ci = (complex float)inter[i];
+      output[i] = cargf(ci);
+    }
+    break;
+  case FFT_REAL:
+    for (i = 0; i < n; i++) {
+      output[i] = crealf(inter[i]);
+    }
+    break;
+  case FFT_IMAG:
+    for (i = 0; i < n; i++) {
+      output[i] = cimagf(inter[i]);
+    }
+    break;
+  case FFT_POWER:
+    for (i = 0; i < n; i++) {
+      float re = crealf(inter[i]);
+      float im = cimagf(inter[i]);
+      output[i] = (double) re * re + (double) im * im;
+    }
+    break;
+  }
+}
+
 static
 gpointer vector_fft_op(gpointer input)
 {
@@ -176,20 +325,25 @@ gpointer vector_fft_op(gpointer input)
 
   //g_message("task data: index %d, width %d, type %u, input %p, nrow %u, ncol %u",d->index,d->width,d->type,d->input,d->nrow,d->ncol);
 
-  if (d->sop.type == FFT_MAG || d->sop.type == FFT_PHASE) {
+  if (d->single)
+    fftwf_execute(d->fplan);
+  else
     fftw_execute(d->plan);
-    int i;
-    if (d->sop.type == FFT_MAG) {
-      for (i = 0; i < d->out_len; i++) {
-        complex double ci = (complex double)d->inter[i];
-        d->output[i] = cabs(ci);
-      }
-    } else {
-      for (i = 0; i < d->out_len; i++) {
-        complex double ci = (complex double)d->inter[i];
-        d->output[i] = carg(ci);
-      }
-    }
+
+  /* either the single component given by type, or one row per component */
+  guint components = d->sop.components;
+  if (components == 0)
+    components = FFT_COMPONENT(d->sop.type);
+  double *out = d->output;
+  int type;
+  for (type = FFT_MAG; type <= FFT_POWER; type++) {
+    if (!(components & FFT_COMPONENT(type)))
+      continue;
+    if (d->single)
+      fft_component_single(d->finter, out, d->out_len, type);
+    else
+      fft_component(d->inter, out, d->out_len, type);
+    out += d->out_len;
   }
   return d->output;
 }
@@ -208,8 +362,19 @@ static void b_fft_operation_class_init(BFFTOperationClass * slice_klass)
 
   g_object_class_install_property(gobject_klass, FFT_PROP_TYPE,
         g_param_spec_int("type", "Type", "Type of FFT operation",
-                        FFT_MAG, FFT_PHASE, FFT_MAG,
+                        FFT_MAG, FFT_POWER, FFT_MAG,
+                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, FFT_PROP_COMPONENTS,
+        g_param_spec_uint("components", "Components",
+                        "Components to output from one transform, as a matrix with one row per component (0 to output only the component given by type)",
+                        0, FFT_COMPONENTS_ALL, 0,
                         G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, FFT_PROP_SINGLE,
+        g_param_spec_boolean("single-precision", "Single precision",
+                        "Transform in single precision (float) if TRUE, double if FALSE.",
+                        FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void b_fft_operation_init(BFFTOperation * fft)
@@ -231,3 +396,1091 @@ BOperation *b_fft_operation_new(int type)
 
   return o;
 }
+
+static const gchar *fft_component_names[] = {
+  "magnitude", "phase", "real", "imaginary", "power"
+};
+
+/**
+ * b_fft_struct_new:
+ * @input: the input vector
+ * @components: the components to include, e.g.
+ *   FFT_COMPONENT(FFT_MAG) | FFT_COMPONENT(FFT_PHASE)
+ * @single: whether to transform in single precision
+ *
+ * Create a #BStruct holding several components of the spectrum of @input,
+ * named "magnitude", "phase", "real", "imaginary" and "power". All of them
+ * come from a single transform each time the input changes.
+ *
+ * Returns: (transfer full): a #BStruct
+ **/
+BData *b_fft_struct_new(BData * input, guint components, gboolean single)
+{
+  g_return_val_if_fail(B_IS_VECTOR(input), NULL);
+  g_return_val_if_fail(components != 0, NULL);
+  g_return_val_if_fail(components <= FFT_COMPONENTS_ALL, NULL);
+
+  BOperation *op = g_object_new(B_TYPE_FFT_OPERATION,
+                                "components", components,
+                                "single-precision", single, NULL);
+  const gchar *names[FFT_POWER + 2];
+  unsigned int n = 0;
+  int type;
+  for (type = FFT_MAG; type <= FFT_POWER; type++) {
+    if (components & FFT_COMPONENT(type))
+      names[n++] = fft_component_names[type];
+  }
+  names[n] = NULL;
+  return b_derived_struct_new(input, op, names);
+}
+
+/****************************************************************************/
+
+/**
+ * BSpectrogramOperation:
+ *
+ * Operation that takes the short-time Fourier transform of a vector.
+ **/
+
+enum {
+  SPEC_PROP_0,
+  SPEC_PROP_TYPE,
+  SPEC_PROP_WINDOW_LENGTH,
+  SPEC_PROP_HOP,
+  SPEC_PROP_WINDOW
+};
+
+/* smallest number of samples worth transforming in a separate thread */
+#define SPEC_MIN_JOB_SAMPLES 65536
+
+struct _BSpectrogramOperation {
+  BOperation base;
+  guchar type;
+  int window_length;
+  int hop;
+  int window;
+};
+
+G_DEFINE_TYPE(BSpectrogramOperation, b_spectrogram_operation, B_TYPE_OPERATION);
+
+static void
+spectrogram_operation_set_property(GObject * gobject, guint param_id,
+                                   GValue const *value, GParamSpec * pspec)
+{
+  BSpectrogramOperation *sop = B_SPECTROGRAM_OPERATION(gobject);
+
+  switch (param_id) {
+  case SPEC_PROP_TYPE:
+    sop->type = g_value_get_int(value);
+    break;
+  case SPEC_PROP_WINDOW_LENGTH:
+    sop->window_length = g_value_get_int(value);
+    break;
+  case SPEC_PROP_HOP:
+    sop->hop = g_value_get_int(value);
+    break;
+  case SPEC_PROP_WINDOW:
+    sop->window = g_value_get_int(value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
+    return;
+  }
+}
+
+static void
+spectrogram_operation_get_property(GObject * gobject, guint param_id,
+                                   GValue * value, GParamSpec * pspec)
+{
+  BSpectrogramOperation *sop = B_SPECTROGRAM_OPERATION(gobject);
+
+  switch (param_id) {
+  case SPEC_PROP_TYPE:
+    g_value_set_int(value, sop->type);
+    break;
+  case SPEC_PROP_WINDOW_LENGTH:
+    g_value_set_int(value, sop->window_length);
+    break;
+  case SPEC_PROP_HOP:
+    g_value_set_int(value, sop->hop);
+    break;
+  case SPEC_PROP_WINDOW:
+    g_value_set_int(value, sop->window);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
+    return;		/* NOTE : RETURN */
+  }
+}
+
+static
+void fft_window_fill(double *w, unsigned int n, int window)
+{
+  unsigned int i;
+  for (i = 0; i < n; i++) {
+    double x = 2 * G_PI * i / n;
+    switch (window) {
+    case FFT_WINDOW_HANN:
+      w[i] = 0.5 - 0.5 * cos(x);
+      break;
+    case FFT_WINDOW_HAMMING:
+      w[i] = 0.54 - 0.46 * cos(x);
+      break;
+    case FFT_WINDOW_BLACKMAN:
+      w[i] = 0.42 - 0.5 * cos(x) + 0.08 * cos(2 * x);
+      break;
+    default:
+      w[i] = 1.0;
+      break;
+    }
+  }
+}
+
+static
+int spectrogram_size(BOperation * op, BData * input, unsigned int *dims)
+{
+  g_assert(B_IS_VECTOR(input));
+  g_assert(dims);
+  BSpectrogramOperation *sop = B_SPECTROGRAM_OPERATION(op);
+  unsigned int len = b_vector_get_len(B_VECTOR(input));
+  unsigned int wl = sop->window_length;
+  dims[0] = (len >= wl) ? (len - wl) / sop->hop + 1 : 0;
+  dims[1] = wl / 2 + 1;
+  return 2;
+}
+
+typedef struct {
+  BSpectrogramOperation sop;
+  double *input;
+  unsigned int len;
+  unsigned int wlen;
+  unsigned int nseg;
+  unsigned int nfreq;
+  int window;
+  double *win;
+  /* segments are transformed in n_jobs batches of seg_per_job, each batch
+     starting at a multiple of job_stride (frames) or job_cstride (inter) */
+  unsigned int n_jobs;
+  unsigned int seg_per_job;
+  size_t job_stride;
+  size_t job_cstride;
+  double *frames;
+  fftw_complex *inter;
+  double *output;
+  fftw_plan plan;
+} SpectrogramOpData;
+
+static
+gpointer spectrogram_op_create_data(BOperation * op, gpointer data,
+                                    BData * input)
+{
+  if (input == NULL)
+    return NULL;
+  SpectrogramOpData *d;
+  gboolean neu = TRUE;
+  if (data == NULL) {
+    d = g_new0(SpectrogramOpData, 1);
+  } else {
+    neu = FALSE;
+    d = (SpectrogramOpData *) data;
+  }
+  BSpectrogramOperation *sop = B_SPECTROGRAM_OPERATION(op);
+  d->sop = *sop;
+  BVector *vec = B_VECTOR(input);
+  d->input = b_create_input_array_from_vector(vec, neu, d->len, d->input);
+  d->len = b_vector_get_len(vec);
+
+  unsigned int dims[2];
+  spectrogram_size(op, input, dims);
+  if (dims[0] == 0) {
+    d->nseg = 0;
+    return d;
+  }
+
+  if (d->wlen != sop->window_length || d->window != sop->window) {
+    g_free(d->win);
+    d->win = g_new(double, sop->window_length);
+    fft_window_fill(d->win, sop->window_length, sop->window);
+    d->window = sop->window;
+  }
+
+  if (d->nseg != dims[0] || d->wlen != sop->window_length) {
+    if (d->plan)
+      fftw_destroy_plan(d->plan);
+    fftw_free(d->frames);
+    fftw_free(d->inter);
+    g_free(d->output);
+    d->nseg = dims[0];
+    d->nfreq = dims[1];
+    d->wlen = sop->window_length;
+    d->n_jobs = b_operation_get_n_jobs((size_t) d->nseg * d->wlen,
+                                       SPEC_MIN_JOB_SAMPLES);
+    d->seg_per_job = (d->nseg + d->n_jobs - 1) / d->n_jobs;
+    d->n_jobs = (d->nseg + d->seg_per_job - 1) / d->seg_per_job;
+    /* keep every batch 64-byte aligned so that one plan can execute on all */
+    d->job_stride = ((size_t) d->seg_per_job * d->wlen + 7) & ~((size_t) 7);
+    d->job_cstride = ((size_t) d->seg_per_job * d->nfreq + 3) & ~((size_t) 3);
+    d->frames = fftw_malloc(sizeof(double) * d->job_stride * d->n_jobs);
+    d->inter = fftw_malloc(sizeof(fftw_complex) * d->job_cstride * d->n_jobs);
+    memset(d->frames, 0, sizeof(double) * d->job_stride * d->n_jobs);
+    d->output = g_new0(double, (size_t) d->nseg * d->nfreq);
+    int n = d->wlen;
+    d->plan = fftw_plan_many_dft_r2c(1, &n, d->seg_per_job,
+                                     d->frames, NULL, 1, d->wlen,
+                                     d->inter, NULL, 1, d->nfreq,
+                                     FFTW_ESTIMATE);
+  }
+  return d;
+}
+
+static
+void spectrogram_op_data_free(gpointer d)
+{
+  SpectrogramOpData *s = (SpectrogramOpData *) d;
+  g_free(s->input);
+  g_free(s->win);
+  fftw_free(s->frames);
+  fftw_free(s->inter);
+  if (s->plan)
+    fftw_destroy_plan(s->plan);
+  g_free(s->output);
+  g_free(d);
+}
+
+static
+void spectrogram_job(unsigned int job, gpointer data)
+{
+  SpectrogramOpData *d = (SpectrogramOpData *) data;
+  unsigned int first = job * d->seg_per_job;
+  unsigned int n = MIN(d->seg_per_job, d->nseg - first);
+  double *frames = d->frames + job * d->job_stride;
+  fftw_complex *inter = d->inter + job * d->job_cstride;
+  unsigned int i, k;
+
+  for (k = 0; k < n; k++) {
+    const double *x = d->input + (size_t) (first + k) * d->sop.hop;
+    double *f = frames + (size_t) k * d->wlen;
+    for (i = 0; i < d->wlen; i++) {
+      f[i] = x[i] * d->win[i];
+    }
+  }
+  /* a short last batch still transforms seg_per_job frames; the extra
+     frames are left over from earlier runs and their output is ignored */
+  fftw_execute_dft_r2c(d->plan, frames, inter);
+  fft_component(inter, d->output + (size_t) first * d->nfreq,
+                n * d->nfreq, d->sop.type);
+}
+
+static
+gpointer spectrogram_op(gpointer input)
+{
+  SpectrogramOpData *d = (SpectrogramOpData *) input;
+
+  if (d == NULL || d->nseg == 0)
+    return NULL;
+
+  b_operation_run_parallel(d->n_jobs, spectrogram_job, d);
+
+  return d->output;
+}
+
+static void
+b_spectrogram_operation_class_init(BSpectrogramOperationClass * spec_klass)
+{
+  GObjectClass *gobject_klass = (GObjectClass *) spec_klass;
+  gobject_klass->set_property = spectrogram_operation_set_property;
+  gobject_klass->get_property = spectrogram_operation_get_property;
+  BOperationClass *op_klass = (BOperationClass *) spec_klass;
+  op_klass->thread_safe = TRUE;
+  op_klass->op_size = spectrogram_size;
+  op_klass->op_func = spectrogram_op;
+  op_klass->op_data = spectrogram_op_create_data;
+  op_klass->op_data_free = spectrogram_op_data_free;
+
+  g_object_class_install_property(gobject_klass, SPEC_PROP_TYPE,
+        g_param_spec_int("type", "Type", "Type of FFT operation",
+                        FFT_MAG, FFT_POWER, FFT_MAG,
+                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, SPEC_PROP_WINDOW_LENGTH,
+        g_param_spec_int("window-length", "Window length",
+                        "Number of samples in each segment",
+                        2, 2000000000, 256,
+                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, SPEC_PROP_HOP,
+        g_param_spec_int("hop", "Hop",
+                        "Number of samples between the starts of segments",
+                        1, 2000000000, 128,
+                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, SPEC_PROP_WINDOW,
+        g_param_spec_int("window", "Window", "Window function",
+                        FFT_WINDOW_RECT, FFT_WINDOW_BLACKMAN, FFT_WINDOW_HANN,
+                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void b_spectrogram_operation_init(BSpectrogramOperation * spec)
+{
+  spec->type = FFT_MAG;
+  spec->window_length = 256;
+  spec->hop = 128;
+  spec->window = FFT_WINDOW_HANN;
+}
+
+/**
+ * b_spectrogram_operation_new:
+ * @window_length: number of samples in each segment
+ * @hop: number of samples between the starts of consecutive segments
+ * @window: the window function, e.g. %FFT_WINDOW_HANN
+ *
+ * Create a new short-time FFT operation. The output is a matrix with one row
+ * per segment and @window_length/2+1 columns.
+ *
+ * Returns: a #BOperation
+ **/
+BOperation *b_spectrogram_operation_new(int window_length, int hop,
+                                        int window)
+{
+  g_return_val_if_fail(window_length >= 2, NULL);
+  g_return_val_if_fail(hop >= 1, NULL);
+
+  BOperation *o = g_object_new(B_TYPE_SPECTROGRAM_OPERATION,
+                               "window-length", window_length,
+                               "hop", hop, "window", window, NULL);
+
+  return o;
+}
+
+/****************************************************************************/
+
+/**
+ * BConvolutionOperation:
+ *
+ * Operation that convolves or correlates a vector using FFTs.
+ **/
+
+enum {
+  CONV_PROP_0,
+  CONV_PROP_TYPE,
+  CONV_PROP_KERNEL
+};
+
+/* smallest transform used for overlap-add, relative to the kernel length */
+#define CONV_OLA_FACTOR 8
+#define CONV_OLA_MIN 4096
+
+struct _BConvolutionOperation {
+  BOperation base;
+  guchar type;
+  BVector *kernel;
+  gulong kernel_handler;
+};
+
+G_DEFINE_TYPE(BConvolutionOperation, b_convolution_operation, B_TYPE_OPERATION);
+
+static void
+on_kernel_changed(BData * data, gpointer user_data)
+{
+  /* make derived data recalculate */
+  g_object_notify(G_OBJECT(user_data), "kernel");
+}
+
+static void
+convolution_operation_set_kernel(BConvolutionOperation * cop, BVector * kernel)
+{
+  if (cop->kernel == kernel)
+    return;
+  if (cop->kernel) {
+    g_signal_handler_disconnect(cop->kernel, cop->kernel_handler);
+    cop->kernel_handler = 0;
+  }
+  g_clear_object(&cop->kernel);
+  if (kernel) {
+    cop->kernel = g_object_ref(kernel);
+    cop->kernel_handler = g_signal_connect(kernel, "changed",
+                                           G_CALLBACK(on_kernel_changed), cop);
+  }
+}
+
+static void
+convolution_operation_set_property(GObject * gobject, guint param_id,
+                                   GValue const *value, GParamSpec * pspec)
+{
+  BConvolutionOperation *cop = B_CONVOLUTION_OPERATION(gobject);
+
+  switch (param_id) {
+  case CONV_PROP_TYPE:
+    cop->type = g_value_get_int(value);
+    break;
+  case CONV_PROP_KERNEL:
+    convolution_operation_set_kernel(cop, g_value_get_object(value));
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
+    return;
+  }
+}
+
+static void
+convolution_operation_get_property(GObject * gobject, guint param_id,
+                                   GValue * value, GParamSpec * pspec)
+{
+  BConvolutionOperation *cop = B_CONVOLUTION_OPERATION(gobject);
+
+  switch (param_id) {
+  case CONV_PROP_TYPE:
+    g_value_set_int(value, cop->type);
+    break;
+  case CONV_PROP_KERNEL:
+    g_value_set_object(value, cop->kernel);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
+    return;		/* NOTE : RETURN */
+  }
+}
+
+static void
+convolution_operation_dispose(GObject * gobject)
+{
+  BConvolutionOperation *cop = B_CONVOLUTION_OPERATION(gobject);
+  convolution_operation_set_kernel(cop, NULL);
+
+  GObjectClass *obj_class = G_OBJECT_CLASS(b_convolution_operation_parent_class);
+  obj_class->dispose(gobject);
+}
+
+/* smallest length >= n with no prime factors larger than 7, which FFTW
+   transforms efficiently */
+static
+unsigned int fft_fast_size(unsigned int n)
+{
+  for (;; n++) {
+    unsigned int m = n;
+    while (m % 2 == 0)
+      m /= 2;
+    while (m % 3 == 0)
+      m /= 3;
+    while (m % 5 == 0)
+      m /= 5;
+    while (m % 7 == 0)
+      m /= 7;
+    if (m == 1)
+      return n;
+  }
+}
+
+static
+int convolution_size(BOperation * op, BData * input, unsigned int *dims)
+{
+  g_assert(B_IS_VECTOR(input));
+  g_assert(dims);
+  BConvolutionOperation *cop = B_CONVOLUTION_OPERATION(op);
+  unsigned int len = b_vector_get_len(B_VECTOR(input));
+  if (cop->type == CONV_AUTO_CORRELATE) {
+    /* non-negative lags only */
+    dims[0] = len;
+  } else if (cop->kernel == NULL || len == 0) {
+    dims[0] = 0;
+  } else {
+    unsigned int klen = b_vector_get_len(cop->kernel);
+    dims[0] = (klen > 0) ? len + klen - 1 : 0;
+  }
+  return 1;
+}
+
+typedef struct {
+  BConvolutionOperation sop;
+  double *input;
+  unsigned int len;
+  /* kernel, reversed for cross-correlation, and its spectrum */
+  double *kernel;
+  unsigned int klen;
+  gboolean kernel_dirty;
+  fftw_complex *kspec;
+  /* transform length and input samples per block */
+  unsigned int n_fft;
+  unsigned int block_len;
+  double *block;
+  fftw_complex *spec;
+  fftw_plan r2c;
+  fftw_plan c2r;
+  double *output;
+  unsigned int out_len;
+} ConvolutionOpData;
+
+static
+void convolution_op_data_clear_plans(ConvolutionOpData * d)
+{
+  g_clear_pointer(&d->r2c, fftw_destroy_plan);
+  g_clear_pointer(&d->c2r, fftw_destroy_plan);
+  g_clear_pointer(&d->block, fftw_free);
+  g_clear_pointer(&d->spec, fftw_free);
+  g_clear_pointer(&d->kspec, fftw_free);
+  d->n_fft = 0;
+}
+
+static
+gpointer convolution_op_create_data(BOperation * op, gpointer data,
+                                    BData * input)
+{
+  if (input == NULL)
+    return NULL;
+  ConvolutionOpData *d;
+  gboolean neu = TRUE;
+  if (data == NULL) {
+    d = g_new0(ConvolutionOpData, 1);
+  } else {
+    neu = FALSE;
+    d = (ConvolutionOpData *) data;
+  }
+  BConvolutionOperation *cop = B_CONVOLUTION_OPERATION(op);
+  d->sop = *cop;
+  d->sop.kernel = NULL;
+  BVector *vec = B_VECTOR(input);
+  d->input = b_create_input_array_from_vector(vec, neu, d->len, d->input);
+  d->len = b_vector_get_len(vec);
+
+  unsigned int dims[1];
+  convolution_size(op, input, dims);
+  if (dims[0] == 0) {
+    d->out_len = 0;
+    return d;
+  }
+
+  /* copy the kernel, recomputing its spectrum only if it changed */
+  if (cop->type != CONV_AUTO_CORRELATE) {
+    unsigned int klen = b_vector_get_len(cop->kernel);
+    const double *k = b_vector_get_values(cop->kernel);
+    if (klen != d->klen) {
+      g_free(d->kernel);
+      d->kernel = g_new0(double, klen);
+      d->klen = klen;
+      d->kernel_dirty = TRUE;
+    }
+    unsigned int i;
+    if (cop->type == CONV_CROSS_CORRELATE) {
+      for (i = 0; i < klen; i++) {
+        if (d->kernel[klen - 1 - i] != k[i]) {
+          d->kernel[klen - 1 - i] = k[i];
+          d->kernel_dirty = TRUE;
+        }
+      }
+    } else if (memcmp(d->kernel, k, klen * sizeof(double)) != 0) {
+      memcpy(d->kernel, k, klen * sizeof(double));
+      d->kernel_dirty = TRUE;
+    }
+  } else {
+    d->klen = 0;
+  }
+
+  /* choose between one transform of the whole signal and overlap-add */
+  unsigned int n_fft;
+  unsigned int block_len;
+  if (cop->type == CONV_AUTO_CORRELATE) {
+    n_fft = fft_fast_size(2 * d->len - 1);
+    block_len = d->len;
+  } else {
+    unsigned int n_whole = fft_fast_size(d->len + d->klen - 1);
+    unsigned int n_block = fft_fast_size(MAX(CONV_OLA_FACTOR * d->klen,
+                                             CONV_OLA_MIN));
+    if (n_block < n_whole) {
+      n_fft = n_block;
+      block_len = n_block - d->klen + 1;
+    } else {
+      n_fft = n_whole;
+      block_len = d->len;
+    }
+  }
+  d->block_len = block_len;
+  if (n_fft != d->n_fft) {
+    convolution_op_data_clear_plans(d);
+    d->n_fft = n_fft;
+    d->block = fftw_malloc(sizeof(double) * n_fft);
+    d->spec = fftw_malloc(sizeof(fftw_complex) * (n_fft / 2 + 1));
+    d->kspec = fftw_malloc(sizeof(fftw_complex) * (n_fft / 2 + 1));
+    d->r2c = fftw_plan_dft_r2c_1d(n_fft, d->block, d->spec, FFTW_ESTIMATE);
+    d->c2r = fftw_plan_dft_c2r_1d(n_fft, d->spec, d->block, FFTW_ESTIMATE);
+    d->kernel_dirty = TRUE;
+  }
+  if (d->out_len != dims[0]) {
+    g_free(d->output);
+    d->output = g_new0(double, dims[0]);
+    d->out_len = dims[0];
+  }
+  return d;
+}
+
+static
+void convolution_op_data_free(gpointer d)
+{
+  ConvolutionOpData *s = (ConvolutionOpData *) d;
+  convolution_op_data_clear_plans(s);
+  g_free(s->input);
+  g_free(s->kernel);
+  g_free(s->output);
+  g_free(d);
+}
+
+/* transform n samples of x, zero padded to the transform length, into spec */
+static
+void convolution_forward(ConvolutionOpData * d, const double *x,
+                         unsigned int n, fftw_complex * spec)
+{
+  memcpy(d->block, x, n * sizeof(double));
+  memset(d->block + n, 0, (d->n_fft - n) * sizeof(double));
+  fftw_execute_dft_r2c(d->r2c, d->block, spec);
+}
+
+static
+gpointer convolution_op(gpointer input)
+{
+  ConvolutionOpData *d = (ConvolutionOpData *) input;
+
+  if (d == NULL || d->out_len == 0)
+    return NULL;
+
+  unsigned int n_spec = d->n_fft / 2 + 1;
+  double scale = 1.0 / d->n_fft;
+  unsigned int i;
+
+  if (d->sop.type == CONV_AUTO_CORRELATE) {
+    convolution_forward(d, d->input, d->len, d->spec);
+    for (i = 0; i < n_spec; i++) {
+      double re = creal(d->spec[i]);
+      double im = cimag(d->spec[i]);
+      d->spec[i] = re * re + im * im;
+    }
+    fftw_execute(d->c2r);
+    for (i = 0; i < d->out_len; i++) {
+      d->output[i] = d->block[i] * scale;
+    }
+    return d->output;
+  }
+
+  if (d->kernel_dirty) {
+    convolution_forward(d, d->kernel, d->klen, d->kspec);
+    d->kernel_dirty = FALSE;
+  }
+
+  /* overlap-add: each block of block_len samples contributes
+     block_len+klen-1 output samples */
+  memset(d->output, 0, d->out_len * sizeof(double));
+  unsigned int start;
+  for (start = 0; start < d->len; start += d->block_len) {
+    unsigned int n = MIN(d->block_len, d->len - start);
+    convolution_forward(d, d->input + start, n, d->spec);
+    for (i = 0; i < n_spec; i++) {
+      d->spec[i] *= d->kspec[i];
+    }
+    fftw_execute(d->c2r);
+    unsigned int n_out = MIN(n + d->klen - 1, d->out_len - start);
+    double *out = d->output + start;
+    for (i = 0; i < n_out; i++) {
+      out[i] += d->block[i] * scale;
+    }
+  }
+  return d->output;
+}
+
+static void
+b_convolution_operation_class_init(BConvolutionOperationClass * conv_klass)
+{
+  GObjectClass *gobject_klass = (GObjectClass *) conv_klass;
+  gobject_klass->set_property = convolution_operation_set_property;
+  gobject_klass->get_property = convolution_operation_get_property;
+  gobject_klass->dispose = convolution_operation_dispose;
+  BOperationClass *op_klass = (BOperationClass *) conv_klass;
+  op_klass->thread_safe = TRUE;
+  op_klass->op_size = convolution_size;
+  op_klass->op_func = convolution_op;
+  op_klass->op_data = convolution_op_create_data;
+  op_klass->op_data_free = convolution_op_data_free;
+
+  g_object_class_install_property(gobject_klass, CONV_PROP_TYPE,
+        g_param_spec_int("type", "Type", "Type of convolution operation",
+                        CONV_CONVOLVE, CONV_AUTO_CORRELATE, CONV_CONVOLVE,
+                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, CONV_PROP_KERNEL,
+        g_param_spec_object("kernel", "Kernel",
+                        "Kernel to convolve with, or second vector to cross-correlate with",
+                        B_TYPE_VECTOR,
+                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void b_convolution_operation_init(BConvolutionOperation * conv)
+{
+  conv->type = CONV_CONVOLVE;
+}
+
+/**
+ * b_convolution_operation_new:
+ * @type: the type of operation, e.g. %CONV_CONVOLVE
+ * @kernel: (nullable): the kernel to convolve with, or the second vector for
+ *   cross-correlation
+ *
+ * Create a new convolution or correlation operation. Convolution outputs
+ * len+klen-1 samples. Cross-correlation outputs the same number, for lags
+ * from -(klen-1) to len-1. Autocorrelation ignores @kernel and outputs len
+ * samples, for lags from 0 to len-1. Recalculation is triggered when @kernel
+ * changes as well as when the input does.
+ *
+ * Returns: a #BOperation
+ **/
+BOperation *b_convolution_operation_new(int type, BVector * kernel)
+{
+  if (kernel)
+    g_return_val_if_fail(B_IS_VECTOR(kernel), NULL);
+
+  BOperation *o = g_object_new(B_TYPE_CONVOLUTION_OPERATION, "type", type,
+                               "kernel", kernel, NULL);
+
+  return o;
+}
+
+/****************************************************************************/
+
+/**
+ * BFFTStream:
+ *
+ * Vector holding the spectrum of the latest frame of a stream of samples.
+ **/
+
+enum {
+  STREAM_PROP_0,
+  STREAM_PROP_INPUT,
+  STREAM_PROP_FRAME_LENGTH,
+  STREAM_PROP_OVERLAP
+};
+
+struct _BFFTStream {
+  BVector base;
+  BData *input;
+  gulong handler;
+  unsigned int consumed;	/* samples of input already pushed */
+  unsigned int frame_length;
+  unsigned int overlap;
+  double *pending;		/* samples of the frame being filled */
+  unsigned int n_pending;
+  guint64 n_frames;
+  BOperation *op;
+  gpointer task_data;
+  BData *frame;
+  double *spectrum;
+  unsigned int spec_len;
+};
+
+G_DEFINE_TYPE(BFFTStream, b_fft_stream, B_TYPE_VECTOR);
+
+static void
+fft_stream_on_input_changed(BData * data, gpointer user_data)
+{
+  BFFTStream *s = B_FFT_STREAM(user_data);
+  unsigned int len = b_vector_get_len(B_VECTOR(data));
+  if (len < s->consumed) {
+    /* input was cleared or replaced, start again from its beginning */
+    s->consumed = 0;
+  }
+  if (len > s->consumed) {
+    const double *v = b_vector_get_values(B_VECTOR(data));
+    unsigned int start = s->consumed;
+    s->consumed = len;
+    b_fft_stream_push(s, v + start, len - start);
+  }
+}
+
+static void
+fft_stream_set_input(BFFTStream * s, BData * input)
+{
+  if (input == s->input)
+    return;
+  if (s->input) {
+    g_signal_handler_disconnect(s->input, s->handler);
+    s->handler = 0;
+  }
+  g_clear_object(&s->input);
+  s->consumed = 0;
+  if (input) {
+    s->input = g_object_ref_sink(input);
+    s->handler = g_signal_connect(input, "changed",
+                                  G_CALLBACK(fft_stream_on_input_changed), s);
+    fft_stream_on_input_changed(input, s);
+  }
+}
+
+static void
+fft_stream_set_frame_length(BFFTStream * s, unsigned int frame_length)
+{
+  s->frame_length = frame_length;
+  g_free(s->pending);
+  s->pending = g_new0(double, s->frame_length);
+  s->n_pending = 0;
+  g_clear_object(&s->frame);
+  s->frame = b_val_vector_new_alloc(s->frame_length);
+  g_object_ref_sink(s->frame);
+}
+
+static void
+fft_stream_set_property(GObject * gobject, guint param_id,
+                        GValue const *value, GParamSpec * pspec)
+{
+  BFFTStream *s = B_FFT_STREAM(gobject);
+
+  switch (param_id) {
+  case STREAM_PROP_INPUT:
+    fft_stream_set_input(s, g_value_get_object(value));
+    break;
+  case STREAM_PROP_FRAME_LENGTH:
+    fft_stream_set_frame_length(s, g_value_get_int(value));
+    break;
+  case STREAM_PROP_OVERLAP:
+    s->overlap = g_value_get_int(value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
+    return;
+  }
+}
+
+static void
+fft_stream_get_property(GObject * gobject, guint param_id,
+                        GValue * value, GParamSpec * pspec)
+{
+  BFFTStream *s = B_FFT_STREAM(gobject);
+
+  switch (param_id) {
+  case STREAM_PROP_INPUT:
+    g_value_set_object(value, s->input);
+    break;
+  case STREAM_PROP_FRAME_LENGTH:
+    g_value_set_int(value, s->frame_length);
+    break;
+  case STREAM_PROP_OVERLAP:
+    g_value_set_int(value, s->overlap);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
+    return;		/* NOTE : RETURN */
+  }
+}
+
+static void fft_stream_constructed(GObject * obj)
+{
+  BFFTStream *s = (BFFTStream *) obj;
+  if (s->frame_length < 2) {
+    g_warning("frame length %u is too short, using 2", s->frame_length);
+    fft_stream_set_frame_length(s, 2);
+  }
+  /* a frame must bring at least one new sample */
+  if (s->overlap >= s->frame_length) {
+    g_warning("overlap %u is not less than frame length %u, using %u",
+              s->overlap, s->frame_length, s->frame_length - 1);
+    s->overlap = s->frame_length - 1;
+  }
+  G_OBJECT_CLASS(b_fft_stream_parent_class)->constructed(obj);
+}
+
+static void fft_stream_finalize(GObject * obj)
+{
+  BFFTStream *s = (BFFTStream *) obj;
+  fft_stream_set_input(s, NULL);
+  if (s->task_data) {
+    BOperationClass *klass = B_OPERATION_GET_CLASS(s->op);
+    klass->op_data_free(s->task_data);
+  }
+  g_clear_object(&s->op);
+  g_clear_object(&s->frame);
+  g_free(s->pending);
+  g_free(s->spectrum);
+
+  GObjectClass *obj_class = G_OBJECT_CLASS(b_fft_stream_parent_class);
+  obj_class->finalize(obj);
+}
+
+static unsigned int fft_stream_load_len(BVector * vec)
+{
+  BFFTStream *s = (BFFTStream *) vec;
+  return s->spec_len;
+}
+
+static double *fft_stream_load_values(BVector * vec)
+{
+  BFFTStream *s = (BFFTStream *) vec;
+  double *v = b_vector_replace_cache(vec, s->spec_len);
+  g_return_val_if_fail(v != NULL, NULL);
+  if (s->spectrum)
+    memcpy(v, s->spectrum, s->spec_len * sizeof(double));
+  return v;
+}
+
+static double fft_stream_get_value(BVector * vec, unsigned i)
+{
+  BFFTStream *s = (BFFTStream *) vec;
+  g_return_val_if_fail(i < s->spec_len, NAN);
+  return s->spectrum[i];
+}
+
+/* transform the pending frame and keep its last overlap samples */
+static void fft_stream_process_frame(BFFTStream * s)
+{
+  BOperationClass *klass = B_OPERATION_GET_CLASS(s->op);
+  double *f = b_val_vector_get_array(B_VAL_VECTOR(s->frame));
+  memcpy(f, s->pending, s->frame_length * sizeof(double));
+  b_data_emit_changed(s->frame);
+  if (s->task_data == NULL)
+    s->task_data = b_operation_create_task_data(s->op, s->frame);
+  else
+    b_operation_update_task_data(s->op, s->task_data, s->frame);
+  double *out = klass->op_func(s->task_data);
+  g_return_if_fail(out != NULL);
+
+  unsigned int dims[2];
+  int n_dims = klass->op_size(s->op, s->frame, dims);
+  unsigned int len = (n_dims == 2) ? dims[0] * dims[1] : dims[0];
+  if (s->spec_len != len) {
+    g_free(s->spectrum);
+    s->spectrum = g_new(double, len);
+    s->spec_len = len;
+  }
+  memcpy(s->spectrum, out, s->spec_len * sizeof(double));
+  s->n_frames++;
+
+  memmove(s->pending, s->pending + s->frame_length - s->overlap,
+          s->overlap * sizeof(double));
+  s->n_pending = s->overlap;
+
+  b_data_emit_changed(B_DATA(s));
+}
+
+static void b_fft_stream_class_init(BFFTStreamClass * klass)
+{
+  GObjectClass *gobject_klass = (GObjectClass *) klass;
+  BVectorClass *vector_klass = (BVectorClass *) klass;
+
+  gobject_klass->constructed = fft_stream_constructed;
+  gobject_klass->finalize = fft_stream_finalize;
+  gobject_klass->set_property = fft_stream_set_property;
+  gobject_klass->get_property = fft_stream_get_property;
+
+  vector_klass->load_len = fft_stream_load_len;
+  vector_klass->load_values = fft_stream_load_values;
+  vector_klass->get_value = fft_stream_get_value;
+
+  g_object_class_install_property(gobject_klass, STREAM_PROP_INPUT,
+        g_param_spec_object("input", "Input data",
+                        "Growing vector whose new samples are transformed",
+                        B_TYPE_VECTOR,
+                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, STREAM_PROP_FRAME_LENGTH,
+        g_param_spec_int("frame-length", "Frame length",
+                        "Number of samples in each transformed frame",
+                        2, 2000000000, 1024,
+                        G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, STREAM_PROP_OVERLAP,
+        g_param_spec_int("overlap", "Overlap",
+                        "Number of samples shared by consecutive frames",
+                        0, 2000000000, 0,
+                        G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+}
+
+static void b_fft_stream_init(BFFTStream * s)
+{
+  s->op = b_fft_operation_new(FFT_MAG);
+}
+
+/**
+ * b_fft_stream_new:
+ * @input: (nullable): a growing vector, or %NULL to feed samples with
+ *   b_fft_stream_push()
+ * @frame_length: number of samples in each frame
+ * @overlap: number of samples shared by consecutive frames
+ *
+ * Create a vector holding the spectrum of the most recent frame of samples.
+ * When @input changes, only the samples appended since the last change are
+ * consumed; a "changed" signal is emitted for every frame completed by them.
+ * Samples of a ring buffer that is already full can't be told apart from old
+ * ones by the length of the vector, so such sources should be fed with
+ * b_fft_stream_push() instead.
+ *
+ * Returns: (transfer full): a #BFFTStream
+ **/
+BData *b_fft_stream_new(BData * input, int frame_length, int overlap)
+{
+  g_return_val_if_fail(frame_length >= 2, NULL);
+  g_return_val_if_fail(overlap >= 0 && overlap < frame_length, NULL);
+  if (input)
+    g_return_val_if_fail(B_IS_VECTOR(input), NULL);
+
+  BData *d = g_object_new(B_TYPE_FFT_STREAM, "frame-length", frame_length,
+                          "overlap", overlap, NULL);
+  if (input)
+    g_object_set(d, "input", input, NULL);
+  return d;
+}
+
+/**
+ * b_fft_stream_get_operation:
+ * @s: a #BFFTStream
+ *
+ * Get the #BFFTOperation used to transform each frame, e.g. to set its type
+ * or precision.
+ *
+ * Returns: (transfer none): the operation
+ **/
+BOperation *b_fft_stream_get_operation(BFFTStream * s)
+{
+  g_return_val_if_fail(B_IS_FFT_STREAM(s), NULL);
+  return s->op;
+}
+
+/**
+ * b_fft_stream_push:
+ * @s: a #BFFTStream
+ * @values: (array length=n): new samples
+ * @n: number of new samples
+ *
+ * Append samples to the stream, transforming every frame they complete.
+ **/
+void b_fft_stream_push(BFFTStream * s, const double *values, unsigned int n)
+{
+  g_return_if_fail(B_IS_FFT_STREAM(s));
+  while (n > 0) {
+    unsigned int m = MIN(n, s->frame_length - s->n_pending);
+    memcpy(s->pending + s->n_pending, values, m * sizeof(double));
+    s->n_pending += m;
+    values += m;
+    n -= m;
+    if (s->n_pending == s->frame_length)
+      fft_stream_process_frame(s);
+  }
+}
+
+/**
+ * b_fft_stream_reset:
+ * @s: a #BFFTStream
+ *
+ * Discard samples that haven't been transformed yet.
+ **/
+void b_fft_stream_reset(BFFTStream * s)
+{
+  g_return_if_fail(B_IS_FFT_STREAM(s));
+  s->n_pending = 0;
+}
+
+/**
+ * b_fft_stream_get_n_frames:
+ * @s: a #BFFTStream
+ *
+ * Get the number of frames transformed so far.
+ *
+ * Returns: the number of frames
+ **/
+guint64 b_fft_stream_get_n_frames(BFFTStream * s)
+{
+  g_return_val_if_fail(B_IS_FFT_STREAM(s), 0);
+  return s->n_frames;
+}
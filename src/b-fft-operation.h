@@ -32,9 +32,51 @@ G_DECLARE_FINAL_TYPE(BFFTOperation,b_fft_operation,B,FFT_OPERATION,BOperation)
 
 enum {
 	FFT_MAG = 0,
-	FFT_PHASE
+	FFT_PHASE,
+	FFT_REAL,
+	FFT_IMAG,
+	FFT_POWER
+};
+
+#define FFT_COMPONENT(type) (1u << (type))
+#define FFT_COMPONENTS_ALL 0x1f
+
+enum {
+	FFT_WINDOW_RECT = 0,
+	FFT_WINDOW_HANN,
+	FFT_WINDOW_HAMMING,
+	FFT_WINDOW_BLACKMAN
 };
 
 BOperation *b_fft_operation_new (int type);
+BData *b_fft_struct_new (BData *input, guint components, gboolean single);
+
+G_DECLARE_FINAL_TYPE(BSpectrogramOperation,b_spectrogram_operation,B,SPECTROGRAM_OPERATION,BOperation)
+
+#define B_TYPE_SPECTROGRAM_OPERATION  (b_spectrogram_operation_get_type ())
+
+BOperation *b_spectrogram_operation_new (int window_length, int hop, int window);
+
+G_DECLARE_FINAL_TYPE(BConvolutionOperation,b_convolution_operation,B,CONVOLUTION_OPERATION,BOperation)
+
+#define B_TYPE_CONVOLUTION_OPERATION  (b_convolution_operation_get_type ())
+
+enum {
+	CONV_CONVOLVE = 0,
+	CONV_CROSS_CORRELATE,
+	CONV_AUTO_CORRELATE
+};
+
+BOperation *b_convolution_operation_new (int type, BVector *kernel);
+
+G_DECLARE_FINAL_TYPE(BFFTStream,b_fft_stream,B,FFT_STREAM,BVector)
+
+#define B_TYPE_FFT_STREAM  (b_fft_stream_get_type ())
+
+BData *b_fft_stream_new (BData *input, int frame_length, int overlap);
+BOperation *b_fft_stream_get_operation (BFFTStream *s);
+void b_fft_stream_push (BFFTStream *s, const double *values, unsigned int n);
+void b_fft_stream_reset (BFFTStream *s);
+guint64 b_fft_stream_get_n_frames (BFFTStream *s);
 
 G_END_DECLS
@@ -0,0 +1,730 @@
+/*
+ * b-hdf-data.c :
+ *
+ * Copyright (C) 2017 Scott O. Johnson (scojo202@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <string.h>
+#include <math.h>
+#include "b-hdf-data.h"
+
+/**
+ * SECTION: b-hdf-data
+ * @short_description: Vectors and matrices read from HDF5 files on demand
+ *
+ * #BH5Vector and #BH5Matrix are backed by a dataset in an HDF5 file. They
+ * read nothing when created; values are read in tiles, using hyperslab
+ * selections, as they are asked for. Tiles have the shape of the dataset's
+ * chunks, so that no chunk has to be decompressed twice, and the most
+ * recently used ones are kept in a cache of bounded size.
+ *
+ * #BSliceOperation and #BSubsetOperation read just the rows, columns or
+ * regions they need from these objects, so a recording much larger than
+ * memory can be browsed. Asking for all values at once, e.g. with
+ * b_matrix_get_values(), reads the whole dataset.
+ *
+ * A stream of matrices or images, as written by #BFileStream, is a three
+ * dimensional dataset; b_h5_matrix_new_frame() gives one of its frames as
+ * a matrix, and b_h5_matrix_set_frame() moves to another one. Integer
+ * datasets, such as image frames, are converted to doubles as they are
+ * read.
+ **/
+
+/* default bound on the memory used by cached tiles, in bytes */
+#define H5_CACHE_BYTES (64 << 20)
+
+/* size of the tiles used for datasets that are not chunked */
+#define H5_TILE_BYTES (1 << 20)
+
+typedef struct {
+  guint64 index;
+  hsize_t rows, columns;
+  double *values;
+} Tile;
+
+/* a dataset read in tiles through an LRU cache; a vector is one column,
+ * and a framed matrix is one frame of a three dimensional dataset */
+typedef struct {
+  BFile *file;
+  gchar *name;
+  hid_t dataset;
+  int rank;
+  gboolean framed;
+  hsize_t frame;
+  hsize_t n_frames;
+  hsize_t dims[2];
+  hsize_t tile[2];
+  hsize_t n_tile_cols;
+  GHashTable *tiles;		/* index -> link in lru */
+  GQueue lru;			/* most recently used first */
+  gsize bytes;
+  gsize max_bytes;
+} H5Cache;
+
+static
+void tile_free(Tile *t)
+{
+  g_free(t->values);
+  g_slice_free(Tile, t);
+}
+
+static
+gboolean h5_cache_open_locked(H5Cache *c, BFile *f, const gchar *data_name,
+                              int rank, gboolean framed, GError **err);
+
+static
+gboolean h5_cache_open(H5Cache *c, BFile *f, const gchar *data_name, int rank,
+                       gboolean framed, GError **err)
+{
+  b_hdf5_lock();
+  gboolean ok = h5_cache_open_locked(c, f, data_name, rank, framed, err);
+  b_hdf5_unlock();
+  return ok;
+}
+
+static
+gboolean h5_cache_open_locked(H5Cache *c, BFile *f, const gchar *data_name,
+                              int rank, gboolean framed, GError **err)
+{
+  int file_rank = framed ? rank + 1 : rank;
+  hid_t file_id = b_file_get_handle(f);
+  if (H5Lexists(file_id, data_name, H5P_DEFAULT) <= 0) {
+    g_set_error(err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                "dataset not found: %s", data_name);
+    return FALSE;
+  }
+  hid_t dataset = H5Dopen(file_id, data_name, H5P_DEFAULT);
+  if (dataset < 0) {
+    g_set_error(err, G_IO_ERROR, G_IO_ERROR_FAILED,
+                "could not open dataset %s", data_name);
+    return FALSE;
+  }
+  hid_t space = H5Dget_space(dataset);
+  if (H5Sget_simple_extent_ndims(space) != file_rank) {
+    g_set_error(err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                "dataset %s does not have rank %d", data_name, file_rank);
+    H5Sclose(space);
+    H5Dclose(dataset);
+    return FALSE;
+  }
+  /* frames are along the first dimension */
+  int k = framed ? 1 : 0;
+  hsize_t file_dims[3] = { 0, 1, 1 };
+  H5Sget_simple_extent_dims(space, file_dims, NULL);
+  H5Sclose(space);
+  c->n_frames = framed ? file_dims[0] : 0;
+  c->dims[0] = file_dims[k];
+  c->dims[1] = rank == 2 ? file_dims[k + 1] : 1;
+
+  /* tiles follow the chunks, or hold whole rows of contiguous data */
+  hsize_t chunk[2] = { 0, 1 };
+  hsize_t file_chunk[3] = { 0, 1, 1 };
+  hid_t plist = H5Dget_create_plist(dataset);
+  if (H5Pget_layout(plist) == H5D_CHUNKED &&
+      H5Pget_chunk(plist, file_rank, file_chunk) == file_rank) {
+    chunk[0] = file_chunk[k];
+    chunk[1] = rank == 2 ? file_chunk[k + 1] : 1;
+  }
+  H5Pclose(plist);
+  if (chunk[0] == 0) {
+    chunk[1] = MAX(c->dims[1], 1);
+    chunk[0] = MAX(1, H5_TILE_BYTES / (chunk[1] * sizeof(double)));
+  }
+  c->tile[0] = chunk[0];
+  c->tile[1] = chunk[1];
+  c->n_tile_cols = (c->dims[1] + c->tile[1] - 1) / c->tile[1];
+
+  c->file = g_object_ref(f);
+  c->name = g_strdup(data_name);
+  c->dataset = dataset;
+  c->rank = rank;
+  c->framed = framed;
+  c->tiles = g_hash_table_new(g_int64_hash, g_int64_equal);
+  g_queue_init(&c->lru);
+  c->max_bytes = H5_CACHE_BYTES;
+  return TRUE;
+}
+
+/* Tiles may be in use by a gather on another thread, e.g. one of the
+ * threads of a derived operation, so the cache is only changed under the
+ * HDF5 lock. */
+static
+void h5_cache_clear(H5Cache *c)
+{
+  b_hdf5_lock();
+  if (c->tiles)
+    g_hash_table_remove_all(c->tiles);
+  g_queue_clear_full(&c->lru, (GDestroyNotify) tile_free);
+  c->bytes = 0;
+  b_hdf5_unlock();
+}
+
+static
+void h5_cache_close(H5Cache *c)
+{
+  h5_cache_clear(c);
+  g_clear_pointer(&c->tiles, g_hash_table_unref);
+  if (c->file) {
+    b_hdf5_lock();
+    H5Dclose(c->dataset);
+    b_hdf5_unlock();
+    g_clear_object(&c->file);
+  }
+  g_clear_pointer(&c->name, g_free);
+}
+
+static
+void h5_cache_trim(H5Cache *c)
+{
+  /* always keep the tile in use */
+  b_hdf5_lock();
+  while (c->bytes > c->max_bytes && g_queue_get_length(&c->lru) > 1) {
+    Tile *t = g_queue_pop_tail(&c->lru);
+    g_hash_table_remove(c->tiles, &t->index);
+    c->bytes -= t->rows * t->columns * sizeof(double);
+    tile_free(t);
+  }
+  b_hdf5_unlock();
+}
+
+static
+hsize_t h5_cache_refresh_locked(H5Cache *c);
+
+/* pick up rows appended since the dataset was opened or last refreshed;
+ * returns the number of new rows */
+static
+hsize_t h5_cache_refresh(H5Cache *c)
+{
+  b_hdf5_lock();
+  hsize_t n = h5_cache_refresh_locked(c);
+  b_hdf5_unlock();
+  return n;
+}
+
+static
+hsize_t h5_cache_refresh_locked(H5Cache *c)
+{
+  hsize_t file_dims[3] = { 0, 1, 1 };
+  herr_t r = H5Drefresh(c->dataset);
+  if (r >= 0) {
+    hid_t space = H5Dget_space(c->dataset);
+    H5Sget_simple_extent_dims(space, file_dims, NULL);
+    H5Sclose(space);
+  }
+  if (r < 0) {
+    g_warning("could not refresh %s", c->name);
+    return 0;
+  }
+  /* frames already written don't change, only new ones are added */
+  if (c->framed) {
+    hsize_t n = file_dims[0] > c->n_frames ? file_dims[0] - c->n_frames : 0;
+    c->n_frames = file_dims[0];
+    return n;
+  }
+  hsize_t dims[2] = { file_dims[0], c->rank == 2 ? file_dims[1] : 1 };
+  if (dims[1] != c->dims[1]) {
+    h5_cache_clear(c);
+    c->dims[0] = dims[0];
+    c->dims[1] = dims[1];
+    c->n_tile_cols = (c->dims[1] + c->tile[1] - 1) / c->tile[1];
+    return dims[0];
+  }
+  if (dims[0] <= c->dims[0])
+    return 0;
+  /* a partly filled band of tiles at the end is now stale */
+  if (c->dims[0] % c->tile[0] != 0) {
+    guint64 ti = c->dims[0] / c->tile[0], tj;
+    for (tj = 0; tj < c->n_tile_cols; tj++) {
+      guint64 index = ti * c->n_tile_cols + tj;
+      GList *link = g_hash_table_lookup(c->tiles, &index);
+      if (link == NULL)
+        continue;
+      Tile *t = link->data;
+      g_hash_table_remove(c->tiles, &index);
+      g_queue_delete_link(&c->lru, link);
+      c->bytes -= t->rows * t->columns * sizeof(double);
+      tile_free(t);
+    }
+  }
+  hsize_t n = dims[0] - c->dims[0];
+  c->dims[0] = dims[0];
+  return n;
+}
+
+/* read a region of the dataset with a hyperslab selection */
+static
+herr_t h5_cache_read(H5Cache *c, hsize_t row, hsize_t col, hsize_t rows,
+                     hsize_t columns, double *out)
+{
+  hsize_t start[3] = { c->frame, 0, 0 };
+  hsize_t count[3] = { 1, 1, 1 };
+  int k = c->framed ? 1 : 0;
+  start[k] = row;
+  start[k + 1] = col;
+  count[k] = rows;
+  count[k + 1] = columns;
+  hid_t file_space = H5Dget_space(c->dataset);
+  hid_t mem_space = H5Screate_simple(c->rank, count + k, NULL);
+  herr_t r = H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, NULL,
+                                 count, NULL);
+  if (r >= 0)
+    r = H5Dread(c->dataset, H5T_NATIVE_DOUBLE, mem_space, file_space,
+                H5P_DEFAULT, out);
+  H5Sclose(mem_space);
+  H5Sclose(file_space);
+  return r;
+}
+
+static
+Tile *h5_cache_get_tile(H5Cache *c, hsize_t ti, hsize_t tj)
+{
+  guint64 index = ti * c->n_tile_cols + tj;
+  GList *link = g_hash_table_lookup(c->tiles, &index);
+  if (link) {
+    g_queue_unlink(&c->lru, link);
+    g_queue_push_head_link(&c->lru, link);
+    return link->data;
+  }
+  Tile *t = g_slice_new(Tile);
+  t->index = index;
+  hsize_t row = ti * c->tile[0], col = tj * c->tile[1];
+  t->rows = MIN(c->tile[0], c->dims[0] - row);
+  t->columns = MIN(c->tile[1], c->dims[1] - col);
+  t->values = g_new(double, t->rows * t->columns);
+  if (h5_cache_read(c, row, col, t->rows, t->columns, t->values) < 0) {
+    g_warning("could not read from %s", c->name);
+    gsize i;
+    for (i = 0; i < t->rows * t->columns; i++)
+      t->values[i] = NAN;
+  }
+  g_queue_push_head(&c->lru, t);
+  g_hash_table_insert(c->tiles, &t->index, c->lru.head);
+  c->bytes += t->rows * t->columns * sizeof(double);
+  h5_cache_trim(c);
+  return t;
+}
+
+/* gather rows and columns starting at (row, col) with the given steps */
+static
+void h5_cache_gather(H5Cache *c, hsize_t row, hsize_t col, hsize_t row_step,
+                     hsize_t col_step, hsize_t rows, hsize_t columns,
+                     double *out)
+{
+  hsize_t i, j;
+  b_hdf5_lock();
+  for (i = 0; i < rows; i++) {
+    hsize_t r = row + i * row_step;
+    hsize_t ti = r / c->tile[0];
+    double *o = out + i * columns;
+    j = 0;
+    while (j < columns) {
+      hsize_t cc = col + j * col_step;
+      hsize_t tj = cc / c->tile[1];
+      Tile *t = h5_cache_get_tile(c, ti, tj);
+      hsize_t col0 = tj * c->tile[1];
+      const double *x = t->values + (r - ti * c->tile[0]) * t->columns;
+      /* last output column that falls in this tile */
+      hsize_t last = col0 + t->columns - 1;
+      hsize_t jend = MIN(columns, (last - col) / col_step + 1);
+      for (; j < jend; j++)
+        o[j] = x[col + j * col_step - col0];
+    }
+  }
+  b_hdf5_unlock();
+}
+
+struct _BH5Vector {
+  BVector base;
+  H5Cache cache;
+};
+
+G_DEFINE_TYPE(BH5Vector, b_h5_vector, B_TYPE_VECTOR);
+
+static
+void h5_vector_finalize(GObject * obj)
+{
+  BH5Vector *v = (BH5Vector *) obj;
+  h5_cache_close(&v->cache);
+  G_OBJECT_CLASS(b_h5_vector_parent_class)->finalize(obj);
+}
+
+static
+unsigned int h5_vector_load_len(BVector * vec)
+{
+  return ((BH5Vector *) vec)->cache.dims[0];
+}
+
+static
+double *h5_vector_load_values(BVector * vec)
+{
+  BH5Vector *v = (BH5Vector *) vec;
+  unsigned int len = v->cache.dims[0];
+  double *x = b_vector_replace_cache(vec, len);
+  if (len > 0 && b_hdf5_read_doubles(v->cache.dataset, x) < 0)
+    g_warning("could not read %s", v->cache.name);
+  return x;
+}
+
+static
+double h5_vector_get_value(BVector * vec, unsigned int i)
+{
+  BH5Vector *v = (BH5Vector *) vec;
+  double x;
+  h5_cache_gather(&v->cache, i, 0, 1, 1, 1, 1, &x);
+  return x;
+}
+
+static void b_h5_vector_class_init(BH5VectorClass * klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+  BVectorClass *vector_klass = (BVectorClass *) klass;
+
+  gobject_class->finalize = h5_vector_finalize;
+
+  vector_klass->load_len = h5_vector_load_len;
+  vector_klass->load_values = h5_vector_load_values;
+  vector_klass->get_value = h5_vector_get_value;
+}
+
+static void b_h5_vector_init(BH5Vector * v)
+{
+}
+
+/**
+ * b_h5_vector_new:
+ * @f: a #BFile
+ * @data_name: name of a one dimensional dataset
+ * @err: (nullable): a #GError or %NULL
+ *
+ * Create a vector whose values are read from a dataset as they are needed.
+ * The vector keeps @f open.
+ *
+ * Returns: (transfer full): the new #BH5Vector, or %NULL on error
+ **/
+BData *b_h5_vector_new(BFile *f, const gchar *data_name, GError **err)
+{
+  g_return_val_if_fail(B_IS_FILE(f), NULL);
+  g_return_val_if_fail(data_name != NULL, NULL);
+  BH5Vector *v = g_object_new(B_TYPE_H5_VECTOR, NULL);
+  if (!h5_cache_open(&v->cache, f, data_name, 1, FALSE, err)) {
+    g_object_unref(v);
+    return NULL;
+  }
+  return B_DATA(v);
+}
+
+/**
+ * b_h5_vector_get_range: (skip)
+ * @v: a #BH5Vector
+ * @start: first element
+ * @step: distance between elements
+ * @len: number of elements
+ * @out: (out caller-allocates): array of @len elements
+ *
+ * Read every @step'th element, starting at @start, through the tile cache.
+ **/
+void b_h5_vector_get_range(BH5Vector *v, unsigned int start,
+                           unsigned int step, unsigned int len, double *out)
+{
+  g_return_if_fail(B_IS_H5_VECTOR(v));
+  g_return_if_fail(step > 0);
+  if (len == 0)
+    return;
+  g_return_if_fail(start + (hsize_t) (len - 1) * step < v->cache.dims[0]);
+  /* a vector is a single column, so this is a column gather */
+  h5_cache_gather(&v->cache, start, 0, step, 1, len, 1, out);
+}
+
+/**
+ * b_h5_vector_set_cache_size:
+ * @v: a #BH5Vector
+ * @bytes: the most memory to use for cached tiles
+ *
+ * Set the bound on the memory used to cache tiles, 64 MB by default.
+ **/
+void b_h5_vector_set_cache_size(BH5Vector *v, gsize bytes)
+{
+  g_return_if_fail(B_IS_H5_VECTOR(v));
+  b_hdf5_lock();
+  v->cache.max_bytes = bytes;
+  h5_cache_trim(&v->cache);
+  b_hdf5_unlock();
+}
+
+/**
+ * b_h5_vector_refresh:
+ * @v: a #BH5Vector
+ *
+ * Look for elements appended to the dataset since @v was created or last
+ * refreshed, e.g. by a process writing the file in SWMR mode (see
+ * b_file_open_for_reading_swmr()). Emits "changed" if there are any; a
+ * viewer following a recording can call this from a timeout.
+ *
+ * Returns: the number of new elements
+ **/
+unsigned int b_h5_vector_refresh(BH5Vector *v)
+{
+  g_return_val_if_fail(B_IS_H5_VECTOR(v), 0);
+  hsize_t n = h5_cache_refresh(&v->cache);
+  if (n > 0)
+    b_data_emit_changed(B_DATA(v));
+  return n;
+}
+
+struct _BH5Matrix {
+  BMatrix base;
+  H5Cache cache;
+};
+
+G_DEFINE_TYPE(BH5Matrix, b_h5_matrix, B_TYPE_MATRIX);
+
+static
+void h5_matrix_finalize(GObject * obj)
+{
+  BH5Matrix *m = (BH5Matrix *) obj;
+  h5_cache_close(&m->cache);
+  G_OBJECT_CLASS(b_h5_matrix_parent_class)->finalize(obj);
+}
+
+static
+BMatrixSize h5_matrix_load_size(BMatrix * mat)
+{
+  BH5Matrix *m = (BH5Matrix *) mat;
+  BMatrixSize size;
+  size.rows = m->cache.dims[0];
+  size.columns = m->cache.dims[1];
+  return size;
+}
+
+static
+double *h5_matrix_load_values(BMatrix * mat)
+{
+  BH5Matrix *m = (BH5Matrix *) mat;
+  hsize_t rows = m->cache.dims[0], columns = m->cache.dims[1];
+  double *x = b_matrix_replace_cache(mat, rows * columns);
+  if (rows * columns == 0)
+    return x;
+  herr_t r;
+  if (m->cache.framed) {
+    b_hdf5_lock();
+    r = h5_cache_read(&m->cache, 0, 0, rows, columns, x);
+    b_hdf5_unlock();
+  } else {
+    r = b_hdf5_read_doubles(m->cache.dataset, x);
+  }
+  if (r < 0)
+    g_warning("could not read %s", m->cache.name);
+  return x;
+}
+
+static
+double h5_matrix_get_value(BMatrix * mat, unsigned int i, unsigned int j)
+{
+  BH5Matrix *m = (BH5Matrix *) mat;
+  double x;
+  h5_cache_gather(&m->cache, i, j, 1, 1, 1, 1, &x);
+  return x;
+}
+
+static void b_h5_matrix_class_init(BH5MatrixClass * klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+  BMatrixClass *matrix_klass = (BMatrixClass *) klass;
+
+  gobject_class->finalize = h5_matrix_finalize;
+
+  matrix_klass->load_size = h5_matrix_load_size;
+  matrix_klass->load_values = h5_matrix_load_values;
+  matrix_klass->get_value = h5_matrix_get_value;
+}
+
+static void b_h5_matrix_init(BH5Matrix * m)
+{
+}
+
+/**
+ * b_h5_matrix_new:
+ * @f: a #BFile
+ * @data_name: name of a two dimensional dataset
+ * @err: (nullable): a #GError or %NULL
+ *
+ * Create a matrix whose values are read from a dataset as they are needed.
+ * The matrix keeps @f open.
+ *
+ * Returns: (transfer full): the new #BH5Matrix, or %NULL on error
+ **/
+BData *b_h5_matrix_new(BFile *f, const gchar *data_name, GError **err)
+{
+  g_return_val_if_fail(B_IS_FILE(f), NULL);
+  g_return_val_if_fail(data_name != NULL, NULL);
+  BH5Matrix *m = g_object_new(B_TYPE_H5_MATRIX, NULL);
+  if (!h5_cache_open(&m->cache, f, data_name, 2, FALSE, err)) {
+    g_object_unref(m);
+    return NULL;
+  }
+  return B_DATA(m);
+}
+
+/**
+ * b_h5_matrix_new_frame:
+ * @f: a #BFile
+ * @data_name: name of a three dimensional dataset, such as a stream of matrices or images
+ * @frame: index along the first dimension
+ * @err: (nullable): a #GError or %NULL
+ *
+ * Create a matrix whose values are one frame of a three dimensional
+ * dataset, read as they are needed. Frames stored as integers are
+ * converted to doubles. The matrix keeps @f open.
+ *
+ * Returns: (transfer full): the new #BH5Matrix, or %NULL on error
+ **/
+BData *b_h5_matrix_new_frame(BFile *f, const gchar *data_name, guint64 frame,
+                             GError **err)
+{
+  g_return_val_if_fail(B_IS_FILE(f), NULL);
+  g_return_val_if_fail(data_name != NULL, NULL);
+  BH5Matrix *m = g_object_new(B_TYPE_H5_MATRIX, NULL);
+  if (!h5_cache_open(&m->cache, f, data_name, 2, TRUE, err)) {
+    g_object_unref(m);
+    return NULL;
+  }
+  if (frame >= m->cache.n_frames) {
+    g_set_error(err, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                "%s has no frame %" G_GUINT64_FORMAT, data_name, frame);
+    g_object_unref(m);
+    return NULL;
+  }
+  m->cache.frame = frame;
+  return B_DATA(m);
+}
+
+/**
+ * b_h5_matrix_set_frame:
+ * @m: a #BH5Matrix made by b_h5_matrix_new_frame()
+ * @frame: index along the first dimension
+ *
+ * Show another frame of the dataset. Cached tiles are dropped, and
+ * "changed" is emitted.
+ **/
+void b_h5_matrix_set_frame(BH5Matrix *m, guint64 frame)
+{
+  g_return_if_fail(B_IS_H5_MATRIX(m));
+  g_return_if_fail(m->cache.framed);
+  g_return_if_fail(frame < m->cache.n_frames);
+  if (frame == m->cache.frame)
+    return;
+  b_hdf5_lock();
+  h5_cache_clear(&m->cache);
+  m->cache.frame = frame;
+  b_hdf5_unlock();
+  b_data_emit_changed(B_DATA(m));
+}
+
+/**
+ * b_h5_matrix_get_frame:
+ * @m: a #BH5Matrix
+ *
+ * Get the index of the frame shown by @m.
+ *
+ * Returns: the frame, or 0 if the dataset is not three dimensional
+ **/
+guint64 b_h5_matrix_get_frame(BH5Matrix *m)
+{
+  g_return_val_if_fail(B_IS_H5_MATRIX(m), 0);
+  return m->cache.frame;
+}
+
+/**
+ * b_h5_matrix_get_n_frames:
+ * @m: a #BH5Matrix
+ *
+ * Get the number of frames in the dataset, as of its last refresh.
+ *
+ * Returns: the number of frames, or 0 if the dataset is not three dimensional
+ **/
+guint64 b_h5_matrix_get_n_frames(BH5Matrix *m)
+{
+  g_return_val_if_fail(B_IS_H5_MATRIX(m), 0);
+  return m->cache.n_frames;
+}
+
+/**
+ * b_h5_matrix_get_region: (skip)
+ * @m: a #BH5Matrix
+ * @row: first row
+ * @col: first column
+ * @row_step: distance between rows
+ * @col_step: distance between columns
+ * @size: number of rows and columns to read
+ * @out: (out caller-allocates): array for the region, stored row by row
+ *
+ * Read a region of the matrix, optionally taking only every @row_step'th
+ * row and @col_step'th column, through the tile cache.
+ **/
+void b_h5_matrix_get_region(BH5Matrix *m, unsigned int row, unsigned int col,
+                            unsigned int row_step, unsigned int col_step,
+                            BMatrixSize size, double *out)
+{
+  g_return_if_fail(B_IS_H5_MATRIX(m));
+  g_return_if_fail(row_step > 0 && col_step > 0);
+  if (size.rows == 0 || size.columns == 0)
+    return;
+  g_return_if_fail(row + (hsize_t) (size.rows - 1) * row_step <
+                   m->cache.dims[0]);
+  g_return_if_fail(col + (hsize_t) (size.columns - 1) * col_step <
+                   m->cache.dims[1]);
+  h5_cache_gather(&m->cache, row, col, row_step, col_step, size.rows,
+                  size.columns, out);
+}
+
+/**
+ * b_h5_matrix_set_cache_size:
+ * @m: a #BH5Matrix
+ * @bytes: the most memory to use for cached tiles
+ *
+ * Set the bound on the memory used to cache tiles, 64 MB by default.
+ **/
+void b_h5_matrix_set_cache_size(BH5Matrix *m, gsize bytes)
+{
+  g_return_if_fail(B_IS_H5_MATRIX(m));
+  b_hdf5_lock();
+  m->cache.max_bytes = bytes;
+  h5_cache_trim(&m->cache);
+  b_hdf5_unlock();
+}
+
+/**
+ * b_h5_matrix_refresh:
+ * @m: a #BH5Matrix
+ *
+ * Look for rows appended to the dataset since @m was created or last
+ * refreshed, e.g. by a process writing the file in SWMR mode (see
+ * b_file_open_for_reading_swmr()). Emits "changed" if there are any. For
+ * a matrix made by b_h5_matrix_new_frame(), look for new frames instead;
+ * the frame shown doesn't change, so nothing is emitted.
+ *
+ * Returns: the number of new rows or frames
+ **/
+unsigned int b_h5_matrix_refresh(BH5Matrix *m)
+{
+  g_return_val_if_fail(B_IS_H5_MATRIX(m), 0);
+  hsize_t n = h5_cache_refresh(&m->cache);
+  if (n > 0 && !m->cache.framed)
+    b_data_emit_changed(B_DATA(m));
+  return n;
+}
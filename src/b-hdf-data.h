@@ -0,0 +1,51 @@
+/*
+ * b-hdf-data.h :
+ *
+ * Copyright (C) 2017 Scott O. Johnson (scojo202@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <data/b-data-class.h>
+#include <b-hdf.h>
+
+G_BEGIN_DECLS
+
+G_DECLARE_FINAL_TYPE(BH5Vector,b_h5_vector,B,H5_VECTOR,BVector)
+
+#define B_TYPE_H5_VECTOR  (b_h5_vector_get_type ())
+
+G_DECLARE_FINAL_TYPE(BH5Matrix,b_h5_matrix,B,H5_MATRIX,BMatrix)
+
+#define B_TYPE_H5_MATRIX  (b_h5_matrix_get_type ())
+
+BData *b_h5_vector_new(BFile *f, const gchar *data_name, GError **err);
+void b_h5_vector_get_range(BH5Vector *v, unsigned int start, unsigned int step, unsigned int len, double *out);
+void b_h5_vector_set_cache_size(BH5Vector *v, gsize bytes);
+unsigned int b_h5_vector_refresh(BH5Vector *v);
+
+BData *b_h5_matrix_new(BFile *f, const gchar *data_name, GError **err);
+BData *b_h5_matrix_new_frame(BFile *f, const gchar *data_name, guint64 frame, GError **err);
+void b_h5_matrix_set_frame(BH5Matrix *m, guint64 frame);
+guint64 b_h5_matrix_get_frame(BH5Matrix *m);
+guint64 b_h5_matrix_get_n_frames(BH5Matrix *m);
+void b_h5_matrix_get_region(BH5Matrix *m, unsigned int row, unsigned int col, unsigned int row_step, unsigned int col_step, BMatrixSize size, double *out);
+void b_h5_matrix_set_cache_size(BH5Matrix *m, gsize bytes);
+unsigned int b_h5_matrix_refresh(BH5Matrix *m);
+
+G_END_DECLS
@@ -19,33 +19,102 @@
  * USA
  */
 
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
 #include <gio/gio.h>
+#include <glib/gstdio.h>
 #include <b-hdf.h>
+#include <b-operation.h>
 #include "data/b-struct.h"
 
 #define DEFLATE_LEVEL 5
 
+/* target size of an automatically chosen chunk, in bytes */
+#define CHUNK_BYTES (1 << 20)
+
+/* smallest amount of chunk data, in bytes, worth inflating on a thread */
+#define INFLATE_MIN_JOB_BYTES (4 << 20)
+
+/* compressed data read ahead of the inflating threads, in bytes */
+#define INFLATE_BATCH_BYTES (64 << 20)
+
+/* smallest amount of chunk data, in bytes, worth compressing on a thread */
+#define DEFLATE_MIN_JOB_BYTES (1 << 20)
+
+/* data compressed before the chunks are handed to HDF5, in bytes */
+#define DEFLATE_BATCH_BYTES (64 << 20)
+
+/* most records held in memory by a stream, in bytes */
+#define STREAM_BUFFER_BYTES (16 << 20)
+
 /**
  * SECTION: b-hdf
  * @short_description: Functions for saving and loading from HDF5 files
  *
  * Utility functions for saving to and loading from HDF5 files.
  *
+ * libhdf5 is not thread safe, so all the functions here and those of
+ * #BH5Vector and #BH5Matrix take a single lock, shared by every file in
+ * the process, around their calls into it. A #BFileWriter takes it for
+ * each request it writes. Code that uses HDF5 handles directly, e.g. from
+ * b_file_get_handle(), in a program with more than one thread should hold
+ * it too, with b_hdf5_lock().
+ **/
+
+/* serializes all calls into libhdf5 in the process */
+static GRecMutex hdf5_lock;
+
+/**
+ * b_hdf5_lock:
+ *
+ * Take the lock held around every call into libhdf5. It is recursive, so
+ * the functions in this library can be called while holding it. Don't
+ * hold it while queueing requests to a #BFileWriter, which may wait for
+ * its thread, and that thread needs the lock.
+ **/
+void b_hdf5_lock(void)
+{
+  g_rec_mutex_lock(&hdf5_lock);
+}
+
+/**
+ * b_hdf5_unlock:
+ *
+ * Release the lock taken by b_hdf5_lock().
  **/
+void b_hdf5_unlock(void)
+{
+  g_rec_mutex_unlock(&hdf5_lock);
+}
 
 struct _BFile {
   GObject	 base;
   hid_t handle;
   gboolean write;
+  BFileStorage storage;
+  gint64 flush_interval;	/* for streams in SWMR mode, microseconds */
+  GList *streams;		/* open streams, under the HDF5 lock */
+  guint flush_source;
 };
 
+static
+void file_flush_streams(BFile *f);
+
 G_DEFINE_TYPE (BFile, b_file, G_TYPE_OBJECT);
 
 static
 void b_file_finalize (GObject *obj)
 {
   BFile *f = (BFile *) obj;
+  if (f->flush_source)
+    g_source_remove(f->flush_source);
+  b_hdf5_lock();
   H5Fclose(f->handle);
+  b_hdf5_unlock();
+  G_OBJECT_CLASS(b_file_parent_class)->finalize(obj);
 }
 
 static
@@ -58,20 +127,123 @@ void b_file_class_init(BFileClass *class)
 static
 void b_file_init(BFile *file)
 {
+  b_file_storage_init(&file->storage);
+}
 
+/**
+ * b_file_storage_init:
+ * @storage: a #BFileStorage
+ *
+ * Set the default storage options: deflate at level 5 after shuffling,
+ * no checksum, and chunks of about 1 MB chosen from the data size. Fixed
+ * size datasets with no filters and no chunk shape are stored contiguously.
+ **/
+void b_file_storage_init(BFileStorage *storage)
+{
+  g_return_if_fail(storage != NULL);
+  memset(storage, 0, sizeof(BFileStorage));
+  storage->deflate = DEFLATE_LEVEL;
+  storage->shuffle = TRUE;
+  storage->fletcher32 = FALSE;
 }
 
 /**
- * b_file_open_for_writing:
- * @filename: filename
- * @overwrite: whether to overwrite the file if it already exists
- * @err: (nullable): a #GError or %NULL
+ * b_file_set_storage:
+ * @f: a #BFile
+ * @storage: storage options
  *
- * Create an HDF5 file for writing.
+ * Set the storage options used for datasets written to @f from now on.
+ **/
+void b_file_set_storage(BFile *f, const BFileStorage *storage)
+{
+  g_return_if_fail(B_IS_FILE(f));
+  g_return_if_fail(storage != NULL);
+  g_return_if_fail(storage->deflate >= 0 && storage->deflate <= 9);
+  f->storage = *storage;
+}
+
+/**
+ * b_file_get_storage:
+ * @f: a #BFile
  *
- * Returns: (transfer full): The #BFile object.
+ * Get the storage options used for datasets written to @f.
+ *
+ * Returns: (transfer none): the storage options
  **/
-BFile * b_file_open_for_writing(const gchar * filename, gboolean overwrite, GError **err)
+const BFileStorage *b_file_get_storage(BFile *f)
+{
+  g_return_val_if_fail(B_IS_FILE(f), NULL);
+  return &f->storage;
+}
+
+/* Pick chunk dimensions of about CHUNK_BYTES, keeping the last dimensions
+ * whole so that chunks hold complete rows where possible. An unlimited
+ * dimension should be given as a large size. */
+static
+void choose_chunk(int rank, const hsize_t *dims, gsize elem_size,
+                  hsize_t *chunk)
+{
+  gsize bytes = elem_size;
+  int i;
+  for (i = 0; i < rank; i++) {
+    chunk[i] = MAX(dims[i], 1);
+    bytes *= chunk[i];
+  }
+  for (i = 0; i < rank && bytes > CHUNK_BYTES; i++) {
+    gsize slice = bytes / chunk[i];
+    chunk[i] = MAX(1, CHUNK_BYTES / slice);
+    bytes = slice * chunk[i];
+  }
+}
+
+/* Make the creation property list for a dataset. Unfiltered datasets
+ * with fixed dimensions are left contiguous unless a chunk shape is
+ * given, so that they can be mapped into memory when read back. */
+static
+hid_t create_dataset_plist(const BFileStorage *storage, int rank,
+                           const hsize_t *dims, const hsize_t *max_dims,
+                           gsize elem_size)
+{
+  BFileStorage def;
+  if (storage == NULL) {
+    b_file_storage_init(&def);
+    storage = &def;
+  }
+  hid_t plist_id = H5Pcreate(H5P_DATASET_CREATE);
+  gboolean filtered = storage->deflate > 0 || storage->shuffle ||
+    storage->fletcher32;
+  gboolean fixed = (max_dims == NULL);
+  hsize_t chunk[3];
+  int i;
+  if (!filtered && fixed && storage->chunk[0] == 0)
+    return plist_id;
+
+  if (storage->chunk[0] > 0) {
+    for (i = 0; i < rank; i++) {
+      chunk[i] = MAX(storage->chunk[i], 1);
+      /* chunks of fixed dimensions can't be larger than the dataset */
+      if (max_dims == NULL || max_dims[i] != H5S_UNLIMITED)
+        chunk[i] = MIN(chunk[i], MAX(dims[i], 1));
+    }
+  } else {
+    hsize_t d[3];
+    for (i = 0; i < rank; i++)
+      d[i] = (max_dims && max_dims[i] == H5S_UNLIMITED) ? G_MAXUINT32 : dims[i];
+    choose_chunk(rank, d, elem_size, chunk);
+  }
+  H5Pset_chunk(plist_id, rank, chunk);
+  if (storage->shuffle)
+    H5Pset_shuffle(plist_id);
+  if (storage->deflate > 0)
+    H5Pset_deflate(plist_id, storage->deflate);
+  if (storage->fletcher32)
+    H5Pset_fletcher32(plist_id);
+  return plist_id;
+}
+
+static
+BFile *file_create(const gchar * filename, gboolean overwrite, hid_t fapl,
+                   GError **err)
 {
   /* make sure file doesn't already exist */
   GFile *file = g_file_new_for_path(filename);
@@ -83,7 +255,9 @@ BFile * b_file_open_for_writing(const gchar * filename, gboolean overwrite, GErr
     if (!overwrite)
       return NULL;
   }
-  hid_t hfile = H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  b_hdf5_lock();
+  hid_t hfile = H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, fapl);
+  b_hdf5_unlock();
   BFile *f = g_object_new(B_TYPE_FILE,NULL);
   f->handle = hfile;
   f->write = TRUE;
@@ -91,16 +265,105 @@ BFile * b_file_open_for_writing(const gchar * filename, gboolean overwrite, GErr
 }
 
 /**
- * b_file_open_for_reading:
+ * b_file_open_for_writing:
  * @filename: filename
+ * @overwrite: whether to overwrite the file if it already exists
  * @err: (nullable): a #GError or %NULL
  *
- * Create an HDF5 file to be read.
+ * Create an HDF5 file for writing.
  *
  * Returns: (transfer full): The #BFile object.
  **/
+BFile * b_file_open_for_writing(const gchar * filename, gboolean overwrite, GError **err)
+{
+  return file_create(filename, overwrite, H5P_DEFAULT, err);
+}
 
-BFile * b_file_open_for_reading(const gchar *filename, GError **err)
+/**
+ * b_file_open_for_writing_swmr:
+ * @filename: filename
+ * @overwrite: whether to overwrite the file if it already exists
+ * @err: (nullable): a #GError or %NULL
+ *
+ * Create an HDF5 file for writing that other processes can read while it
+ * is written (single writer, multiple readers). The file uses the latest
+ * HDF5 format. Create its streams, then call b_file_start_swmr(); no
+ * datasets or groups can be added after that.
+ *
+ * Returns: (transfer full): The #BFile object.
+ **/
+BFile * b_file_open_for_writing_swmr(const gchar * filename,
+                                     gboolean overwrite, GError **err)
+{
+  b_hdf5_lock();
+  hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_libver_bounds(fapl, H5F_LIBVER_LATEST, H5F_LIBVER_LATEST);
+  BFile *f = file_create(filename, overwrite, fapl, err);
+  H5Pclose(fapl);
+  b_hdf5_unlock();
+  return f;
+}
+
+static
+void weak_ref_free(GWeakRef *ref)
+{
+  g_weak_ref_clear(ref);
+  g_free(ref);
+}
+
+static
+gboolean file_flush_timeout(gpointer data)
+{
+  /* the file may be finalized on another thread, which removes this */
+  BFile *f = g_weak_ref_get((GWeakRef *) data);
+  if (f == NULL)
+    return G_SOURCE_CONTINUE;
+  file_flush_streams(f);
+  g_object_unref(f);
+  return G_SOURCE_CONTINUE;
+}
+
+/**
+ * b_file_start_swmr:
+ * @f: a #BFile made by b_file_open_for_writing_swmr()
+ * @flush_interval: most time, in milliseconds, that appended records are kept from readers
+ * @err: (nullable): a #GError or %NULL
+ *
+ * Let readers opened with b_file_open_for_reading_swmr() follow the file
+ * as records are appended to its streams. As well as when their buffer
+ * fills, streams holding records are flushed once @flush_interval has
+ * passed since their last flush, from a timeout in the default main
+ * context, so records appended just before acquisition pauses are not
+ * held back. The thread of a #BFileWriter on @f does the same, for
+ * programs that don't run a main loop.
+ *
+ * Returns: %TRUE on success
+ **/
+gboolean b_file_start_swmr(BFile *f, guint flush_interval, GError **err)
+{
+  g_return_val_if_fail(B_IS_FILE(f), FALSE);
+  g_return_val_if_fail(f->write, FALSE);
+  b_hdf5_lock();
+  herr_t r = H5Fstart_swmr_write(f->handle);
+  b_hdf5_unlock();
+  if (r < 0) {
+    g_set_error(err, G_IO_ERROR, G_IO_ERROR_FAILED,
+                "could not start SWMR writing");
+    return FALSE;
+  }
+  f->flush_interval = (gint64) flush_interval * 1000;
+  if (flush_interval > 0 && f->flush_source == 0) {
+    GWeakRef *ref = g_new(GWeakRef, 1);
+    g_weak_ref_init(ref, f);
+    f->flush_source = g_timeout_add_full(G_PRIORITY_DEFAULT, flush_interval,
+                                         file_flush_timeout, ref,
+                                         (GDestroyNotify) weak_ref_free);
+  }
+  return TRUE;
+}
+
+static
+BFile *file_open(const gchar *filename, unsigned int flags, GError **err)
 {
   /* make sure file exists */
   GFile *file = g_file_new_for_path(filename);
@@ -112,19 +375,57 @@ BFile * b_file_open_for_reading(const gchar *filename, GError **err)
     return NULL;
   }
   /* make sure file is not corrupted */
+  b_hdf5_lock();
   htri_t r = H5Fis_hdf5(filename);
+  hid_t hfile = r > 0 ? H5Fopen(filename, flags, H5P_DEFAULT) : -1;
+  b_hdf5_unlock();
   if(r<=0) {
     g_set_error(err, G_IO_ERROR, G_IO_ERROR_FAILED,
                 "file is not HDF5 format: %s", filename);
     return NULL;
   }
-  hid_t hfile = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+  if (hfile < 0) {
+    g_set_error(err, G_IO_ERROR, G_IO_ERROR_FAILED,
+                "could not open file: %s", filename);
+    return NULL;
+  }
   BFile *f = g_object_new(B_TYPE_FILE,NULL);
   f->handle = hfile;
   f->write = FALSE;
   return f;
 }
 
+/**
+ * b_file_open_for_reading:
+ * @filename: filename
+ * @err: (nullable): a #GError or %NULL
+ *
+ * Create an HDF5 file to be read.
+ *
+ * Returns: (transfer full): The #BFile object.
+ **/
+
+BFile * b_file_open_for_reading(const gchar *filename, GError **err)
+{
+  return file_open(filename, H5F_ACC_RDONLY, err);
+}
+
+/**
+ * b_file_open_for_reading_swmr:
+ * @filename: filename
+ * @err: (nullable): a #GError or %NULL
+ *
+ * Open an HDF5 file that another process is writing in SWMR mode. Use
+ * b_h5_vector_refresh() or b_h5_matrix_refresh() to see records appended
+ * after the file was opened.
+ *
+ * Returns: (transfer full): The #BFile object.
+ **/
+BFile * b_file_open_for_reading_swmr(const gchar *filename, GError **err)
+{
+  return file_open(filename, H5F_ACC_RDONLY | H5F_ACC_SWMR_READ, err);
+}
+
 /**
  * b_file_get_handle: (skip)
  * @f: a #BFile
@@ -146,7 +447,434 @@ hid_t b_file_get_handle(BFile *f)
 hid_t b_hdf5_create_group(hid_t id, const gchar * name)
 {
   g_return_val_if_fail(id != 0, 0);
-  return H5Gcreate(id, name, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  b_hdf5_lock();
+  hid_t group = H5Gcreate(id, name, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  b_hdf5_unlock();
+  return group;
+}
+
+typedef struct {
+  hsize_t offset[2];
+  guchar *raw;			/* NULL for a chunk that was never written */
+  gsize raw_size;
+  guint32 filter_mask;
+} RawChunk;
+
+typedef struct {
+  RawChunk *chunks;
+  unsigned int n_chunks;
+  hsize_t dims[2];
+  hsize_t chunk[2];
+  int shuffle;			/* index in the filter pipeline, or -1 */
+  int deflate;
+  double *out;
+  unsigned int n_jobs;
+  gint failed;
+} InflateData;
+
+static
+void unshuffle(const guchar *in, guchar *out, gsize n, gsize elem_size)
+{
+  gsize i, b;
+  for (b = 0; b < elem_size; b++) {
+    const guchar *x = in + b * n;
+    for (i = 0; i < n; i++)
+      out[i * elem_size + b] = x[i];
+  }
+}
+
+static
+void inflate_job(unsigned int job, gpointer data)
+{
+  InflateData *d = (InflateData *) data;
+  unsigned int first = (unsigned int) (((size_t) d->n_chunks * job) / d->n_jobs);
+  unsigned int last = (unsigned int) (((size_t) d->n_chunks * (job + 1)) / d->n_jobs);
+  gsize n = d->chunk[0] * d->chunk[1];
+  gsize chunk_bytes = n * sizeof(double);
+  guchar *scratch = g_malloc(chunk_bytes);
+  guchar *scratch2 = g_malloc(chunk_bytes);
+  unsigned int k;
+  hsize_t i;
+
+  for (k = first; k < last && !g_atomic_int_get(&d->failed); k++) {
+    RawChunk *c = &d->chunks[k];
+    const guchar *src = c->raw;
+    if (src == NULL) {
+      memset(scratch, 0, chunk_bytes);
+      src = scratch;
+    } else {
+      if (d->deflate >= 0 && !(c->filter_mask & (1u << d->deflate))) {
+        uLongf len = chunk_bytes;
+        if (uncompress(scratch, &len, c->raw, c->raw_size) != Z_OK ||
+            len != chunk_bytes) {
+          g_atomic_int_set(&d->failed, 1);
+          break;
+        }
+        src = scratch;
+      }
+      if (d->shuffle >= 0 && !(c->filter_mask & (1u << d->shuffle))) {
+        unshuffle(src, scratch2, n, sizeof(double));
+        src = scratch2;
+      } else if (src == c->raw && c->raw_size != chunk_bytes) {
+        g_atomic_int_set(&d->failed, 1);
+        break;
+      }
+    }
+    /* chunks at the edges reach past the end of the dataset */
+    hsize_t rows = MIN(d->chunk[0], d->dims[0] - c->offset[0]);
+    hsize_t cols = MIN(d->chunk[1], d->dims[1] - c->offset[1]);
+    for (i = 0; i < rows; i++)
+      memcpy(d->out + (c->offset[0] + i) * d->dims[1] + c->offset[1],
+             src + i * d->chunk[1] * sizeof(double), cols * sizeof(double));
+  }
+  g_free(scratch);
+  g_free(scratch2);
+}
+
+static
+void free_raw_chunks(InflateData *d)
+{
+  unsigned int k;
+  for (k = 0; k < d->n_chunks; k++)
+    g_clear_pointer(&d->chunks[k].raw, g_free);
+  d->n_chunks = 0;
+}
+
+/* Read a whole chunked dataset of doubles by fetching the raw chunks here
+ * and inflating them on several threads. Returns FALSE, having possibly
+ * written part of @out, if the dataset is not suitable. */
+static
+gboolean read_chunks_parallel(hid_t dataset, double *out)
+{
+  InflateData d;
+  memset(&d, 0, sizeof(InflateData));
+  d.shuffle = d.deflate = -1;
+  d.dims[1] = d.chunk[1] = 1;
+
+  hid_t space = H5Dget_space(dataset);
+  int rank = H5Sget_simple_extent_ndims(space);
+  if (rank == 1 || rank == 2)
+    H5Sget_simple_extent_dims(space, d.dims, NULL);
+  H5Sclose(space);
+  if (rank != 1 && rank != 2)
+    return FALSE;
+  if (d.dims[0] * d.dims[1] * sizeof(double) < INFLATE_MIN_JOB_BYTES)
+    return FALSE;
+
+  hid_t type = H5Dget_type(dataset);
+  gboolean ok = H5Tequal(type, H5T_NATIVE_DOUBLE) > 0;
+  H5Tclose(type);
+
+  /* only the filters written by BFile are undone here */
+  hid_t plist = H5Dget_create_plist(dataset);
+  if (ok && H5Pget_layout(plist) == H5D_CHUNKED &&
+      H5Pget_chunk(plist, rank, d.chunk) == rank) {
+    int i, n = H5Pget_nfilters(plist);
+    for (i = 0; i < n && ok; i++) {
+      unsigned int flags;
+      size_t cd_nelmts = 0;
+      H5Z_filter_t id = H5Pget_filter2(plist, i, &flags, &cd_nelmts, NULL, 0,
+                                       NULL, NULL);
+      if (id == H5Z_FILTER_SHUFFLE && d.deflate < 0 && d.shuffle < 0)
+        d.shuffle = i;
+      else if (id == H5Z_FILTER_DEFLATE && d.deflate < 0)
+        d.deflate = i;
+      else
+        ok = FALSE;
+    }
+  } else {
+    ok = FALSE;
+  }
+  H5Pclose(plist);
+  if (!ok)
+    return FALSE;
+
+  hsize_t n_rows = (d.dims[0] + d.chunk[0] - 1) / d.chunk[0];
+  hsize_t n_cols = (d.dims[1] + d.chunk[1] - 1) / d.chunk[1];
+  gsize max_chunks = MAX(1, INFLATE_BATCH_BYTES /
+                         (d.chunk[0] * d.chunk[1] * sizeof(double)));
+  d.chunks = g_new0(RawChunk, MIN(max_chunks, n_rows * n_cols));
+  d.out = out;
+  hsize_t ti, tj;
+  gsize batch_bytes = 0;
+  for (ti = 0; ti < n_rows && ok; ti++) {
+    for (tj = 0; tj < n_cols && ok; tj++) {
+      RawChunk *c = &d.chunks[d.n_chunks++];
+      c->offset[0] = ti * d.chunk[0];
+      c->offset[1] = tj * d.chunk[1];
+      hsize_t size = 0;
+      if (H5Dget_chunk_storage_size(dataset, c->offset, &size) >= 0 &&
+          size > 0) {
+        c->raw = g_malloc(size);
+        c->raw_size = size;
+        if (H5Dread_chunk(dataset, H5P_DEFAULT, c->offset, &c->filter_mask,
+                          c->raw) < 0)
+          ok = FALSE;
+      }
+      batch_bytes += d.chunk[0] * d.chunk[1] * sizeof(double);
+      gboolean end = (ti == n_rows - 1 && tj == n_cols - 1);
+      if (ok && (d.n_chunks == max_chunks || end)) {
+        d.n_jobs = MIN(b_operation_get_n_jobs(batch_bytes,
+                                              INFLATE_MIN_JOB_BYTES),
+                       d.n_chunks);
+        b_operation_run_parallel(d.n_jobs, inflate_job, &d);
+        ok = !d.failed;
+        free_raw_chunks(&d);
+        batch_bytes = 0;
+      }
+    }
+  }
+  free_raw_chunks(&d);
+  g_free(d.chunks);
+  return ok;
+}
+
+/**
+ * b_hdf5_read_doubles: (skip)
+ * @dataset: HDF5 dataset
+ * @out: array large enough for the whole dataset
+ *
+ * Read a whole dataset as doubles. Large datasets compressed by BFile are
+ * read chunk by chunk, and the chunks are inflated on several threads,
+ * rather than one after another inside H5Dread().
+ *
+ * Returns: a negative value on error
+ **/
+herr_t b_hdf5_read_doubles(hid_t dataset, double *out)
+{
+  g_return_val_if_fail(out != NULL, -1);
+  herr_t r = 0;
+  b_hdf5_lock();
+  if (!read_chunks_parallel(dataset, out))
+    r = H5Dread(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                out);
+  b_hdf5_unlock();
+  return r;
+}
+
+/* write rows [row, row + n) of a dataset, complete in the other dimensions */
+static
+herr_t write_hyperslab(hid_t dataset, hid_t mem_type, int rank,
+                       const hsize_t *dims, hsize_t row, hsize_t n,
+                       const void *data)
+{
+  hsize_t start[3] = { row, 0, 0 };
+  hsize_t count[3] = { n, 0, 0 };
+  int i;
+  for (i = 1; i < rank; i++)
+    count[i] = dims[i];
+  hid_t file_space = H5Dget_space(dataset);
+  hid_t mem_space = H5Screate_simple(rank, count, NULL);
+  herr_t r = H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, NULL,
+                                 count, NULL);
+  if (r >= 0)
+    r = H5Dwrite(dataset, mem_type, mem_space, file_space, H5P_DEFAULT, data);
+  H5Sclose(mem_space);
+  H5Sclose(file_space);
+  return r;
+}
+
+typedef struct {
+  hsize_t offset[3];
+  guchar *packed;
+  gsize packed_size;
+} PackedChunk;
+
+typedef struct {
+  PackedChunk *chunks;
+  unsigned int n_chunks;
+  hsize_t dims[3];
+  hsize_t chunk[3];
+  hsize_t row, n;		/* rows held in data */
+  const guchar *data;
+  gsize elem_size;
+  gboolean shuffle;
+  int deflate;
+  unsigned int n_jobs;
+  gint failed;
+} DeflateData;
+
+static
+void shuffle(const guchar *in, guchar *out, gsize n, gsize elem_size)
+{
+  gsize i, b;
+  for (b = 0; b < elem_size; b++) {
+    guchar *o = out + b * n;
+    for (i = 0; i < n; i++)
+      o[i] = in[i * elem_size + b];
+  }
+}
+
+static
+void deflate_job(unsigned int job, gpointer data)
+{
+  DeflateData *d = (DeflateData *) data;
+  unsigned int first = (unsigned int) (((size_t) d->n_chunks * job) / d->n_jobs);
+  unsigned int last = (unsigned int) (((size_t) d->n_chunks * (job + 1)) / d->n_jobs);
+  gsize es = d->elem_size;
+  gsize n = d->chunk[0] * d->chunk[1] * d->chunk[2];
+  gsize chunk_bytes = n * es;
+  guchar *scratch = g_malloc(chunk_bytes);
+  guchar *scratch2 = g_malloc(chunk_bytes);
+  unsigned int k;
+  hsize_t i, j;
+
+  for (k = first; k < last && !g_atomic_int_get(&d->failed); k++) {
+    PackedChunk *c = &d->chunks[k];
+    hsize_t rows = MIN(d->chunk[0], d->row + d->n - c->offset[0]);
+    hsize_t cols = MIN(d->chunk[1], d->dims[1] - c->offset[1]);
+    hsize_t deep = MIN(d->chunk[2], d->dims[2] - c->offset[2]);
+    /* chunks at the edges are stored whole, padded with zeros */
+    if (rows < d->chunk[0] || cols < d->chunk[1] || deep < d->chunk[2])
+      memset(scratch, 0, chunk_bytes);
+    for (i = 0; i < rows; i++) {
+      for (j = 0; j < cols; j++) {
+        gsize src = ((c->offset[0] + i - d->row) * d->dims[1] +
+                     c->offset[1] + j) * d->dims[2] + c->offset[2];
+        memcpy(scratch + (i * d->chunk[1] + j) * d->chunk[2] * es,
+               d->data + src * es, deep * es);
+      }
+    }
+    const guchar *src = scratch;
+    if (d->shuffle && es > 1) {
+      shuffle(scratch, scratch2, n, es);
+      src = scratch2;
+    }
+    if (d->deflate > 0) {
+      uLongf len = compressBound(chunk_bytes);
+      c->packed = g_malloc(len);
+      if (compress2(c->packed, &len, src, chunk_bytes, d->deflate) != Z_OK) {
+        g_atomic_int_set(&d->failed, 1);
+        break;
+      }
+      c->packed_size = len;
+    } else {
+      c->packed = g_memdup(src, chunk_bytes);
+      c->packed_size = chunk_bytes;
+    }
+  }
+  g_free(scratch);
+  g_free(scratch2);
+}
+
+static
+void free_packed_chunks(DeflateData *d)
+{
+  unsigned int k;
+  for (k = 0; k < d->n_chunks; k++)
+    g_clear_pointer(&d->chunks[k].packed, g_free);
+  d->n_chunks = 0;
+}
+
+/* Write rows [row, row + n) of a dataset of @rank dimensions @dims, the
+ * rows being complete in the other dimensions. Whole chunks are filtered
+ * on several threads as set by @storage and handed to HDF5 with
+ * H5Dwrite_chunk from this thread; chunks that already hold other data
+ * and datasets with a checksum are written with H5Dwrite. @chunk is NULL
+ * for contiguous datasets. */
+static
+herr_t write_rows(hid_t dataset, hid_t mem_type, const BFileStorage *storage,
+                  int rank, const hsize_t *dims, const hsize_t *chunk,
+                  hsize_t row, hsize_t n, const void *data)
+{
+  if (chunk == NULL || storage->fletcher32)
+    return write_hyperslab(dataset, mem_type, rank, dims, row, n, data);
+
+  DeflateData d;
+  memset(&d, 0, sizeof(DeflateData));
+  int i;
+  for (i = 0; i < 3; i++) {
+    d.dims[i] = i < rank ? dims[i] : 1;
+    d.chunk[i] = i < rank ? chunk[i] : 1;
+  }
+  d.elem_size = H5Tget_size(mem_type);
+  gsize row_bytes = d.dims[1] * d.dims[2] * d.elem_size;
+  const guchar *x = data;
+  herr_t r;
+
+  /* rows that share a chunk with rows written before */
+  hsize_t head = (row % d.chunk[0]) ? MIN(n, d.chunk[0] - row % d.chunk[0]) : 0;
+  if (head > 0) {
+    r = write_hyperslab(dataset, mem_type, rank, dims, row, head, x);
+    if (r < 0)
+      return r;
+    row += head;
+    n -= head;
+    x += head * row_bytes;
+  }
+  /* rows that share a chunk with rows that exist but aren't written */
+  hsize_t tail = 0;
+  if ((row + n) % d.chunk[0] != 0 && row + n < d.dims[0])
+    tail = MIN(n, (row + n) % d.chunk[0]);
+  if (tail > 0) {
+    r = write_hyperslab(dataset, mem_type, rank, dims, row + n - tail, tail,
+                        x + (n - tail) * row_bytes);
+    if (r < 0)
+      return r;
+    n -= tail;
+  }
+  if (n == 0)
+    return 0;
+
+  d.row = row;
+  d.n = n;
+  d.data = x;
+  d.shuffle = storage->shuffle;
+  d.deflate = storage->deflate;
+  gsize chunk_bytes = d.chunk[0] * d.chunk[1] * d.chunk[2] * d.elem_size;
+  gsize max_chunks = MAX(1, DEFLATE_BATCH_BYTES / chunk_bytes);
+  hsize_t n_rows = (n + d.chunk[0] - 1) / d.chunk[0];
+  hsize_t n_cols = (d.dims[1] + d.chunk[1] - 1) / d.chunk[1];
+  hsize_t n_deep = (d.dims[2] + d.chunk[2] - 1) / d.chunk[2];
+  d.chunks = g_new0(PackedChunk, MIN(max_chunks, n_rows * n_cols * n_deep));
+  hsize_t ti, tj, tk;
+  unsigned int k;
+  r = 0;
+  for (ti = 0; ti < n_rows && r >= 0; ti++) {
+    for (tj = 0; tj < n_cols && r >= 0; tj++) {
+      for (tk = 0; tk < n_deep && r >= 0; tk++) {
+        PackedChunk *c = &d.chunks[d.n_chunks++];
+        c->offset[0] = row + ti * d.chunk[0];
+        c->offset[1] = tj * d.chunk[1];
+        c->offset[2] = tk * d.chunk[2];
+        gboolean end = (ti == n_rows - 1 && tj == n_cols - 1 &&
+                        tk == n_deep - 1);
+        if (d.n_chunks < max_chunks && !end)
+          continue;
+        d.n_jobs = MIN(b_operation_get_n_jobs(d.n_chunks * chunk_bytes,
+                                              DEFLATE_MIN_JOB_BYTES),
+                       d.n_chunks);
+        b_operation_run_parallel(d.n_jobs, deflate_job, &d);
+        if (d.failed)
+          r = -1;
+        for (k = 0; k < d.n_chunks && r >= 0; k++)
+          r = H5Dwrite_chunk(dataset, H5P_DEFAULT, 0, d.chunks[k].offset,
+                             d.chunks[k].packed_size, d.chunks[k].packed);
+        free_packed_chunks(&d);
+      }
+    }
+  }
+  free_packed_chunks(&d);
+  g_free(d.chunks);
+  return r;
+}
+
+/* write a whole dataset just created with @plist_id */
+static
+herr_t write_dataset(hid_t dataset, hid_t plist_id, hid_t mem_type,
+                     const BFileStorage *storage, int rank,
+                     const hsize_t *dims, const void *data)
+{
+  BFileStorage def;
+  if (storage == NULL) {
+    b_file_storage_init(&def);
+    storage = &def;
+  }
+  hsize_t chunk[3];
+  gboolean chunked = H5Pget_layout(plist_id) == H5D_CHUNKED &&
+    H5Pget_chunk(plist_id, rank, chunk) == rank;
+  return write_rows(dataset, mem_type, storage, rank, dims,
+                    chunked ? chunk : NULL, 0, dims[0], data);
 }
 
 /**
@@ -155,10 +883,27 @@ hid_t b_hdf5_create_group(hid_t id, const gchar * name)
  * @group_id: HDF5 group
  * @data_name: name
  *
- * Add a vector to an HDF5 group.
+ * Add a vector to an HDF5 group, with the default storage options.
  **/
 
 void b_vector_attach_h5(BVector * v, hid_t group_id, const gchar * data_name)
+{
+  b_vector_attach_h5_full(v, group_id, data_name, NULL);
+}
+
+/**
+ * b_vector_attach_h5_full: (skip)
+ * @v: #BVector
+ * @group_id: HDF5 group
+ * @data_name: name
+ * @storage: (nullable): storage options, or %NULL for the defaults
+ *
+ * Add a vector to an HDF5 group.
+ **/
+
+void b_vector_attach_h5_full(BVector * v, hid_t group_id,
+                             const gchar * data_name,
+                             const BFileStorage * storage)
 {
   g_return_if_fail(B_IS_VECTOR(v));
   g_return_if_fail(group_id != 0);
@@ -167,24 +912,24 @@ void b_vector_attach_h5(BVector * v, hid_t group_id, const gchar * data_name)
     g_warning("skipping HDF5 save due to zero length vector");
     return;
   }
+  /* values may come from HDF5 too, maybe on other threads */
+  const double *data = b_vector_get_values(v);
 
+  b_hdf5_lock();
   hid_t dataspace_id = H5Screate_simple(1, dims, NULL);
-  hid_t plist_id = H5Pcreate(H5P_DATASET_CREATE);
-
-  H5Pset_chunk(plist_id, 1, dims);
-  H5Pset_deflate(plist_id, DEFLATE_LEVEL);
+  hid_t plist_id = create_dataset_plist(storage, 1, dims, NULL,
+                                        sizeof(double));
 
   hid_t id =
     H5Dcreate2(group_id, data_name, H5T_NATIVE_DOUBLE, dataspace_id,
                H5P_DEFAULT, plist_id, H5P_DEFAULT);
-  const double *data = b_vector_get_values(v);
-  H5Dwrite(id, H5T_NATIVE_DOUBLE, dataspace_id, dataspace_id, H5P_DEFAULT,
-            data);
+  write_dataset(id, plist_id, H5T_NATIVE_DOUBLE, storage, 1, dims, data);
 
   H5Sclose(dataspace_id);
 
   H5Pclose(plist_id);
   H5Dclose(id);
+  b_hdf5_unlock();
 }
 
 /**
@@ -209,7 +954,9 @@ void b_vector_attach_attr_h5(BVector * v, hid_t group_id,
     return;
   }
 
+  b_hdf5_lock();
   H5LTset_attribute_double(group_id, obj_name, attr_name, d, l);
+  b_hdf5_unlock();
 }
 
 /**
@@ -218,40 +965,65 @@ void b_vector_attach_attr_h5(BVector * v, hid_t group_id,
  * @group_id: HDF5 group
  * @data_name: name
  *
- * Add a matrix to an HDF5 group.
+ * Add a matrix to an HDF5 group, with the default storage options.
  **/
 void b_matrix_attach_h5(BMatrix * m, hid_t group_id, const gchar * data_name)
+{
+  b_matrix_attach_h5_full(m, group_id, data_name, NULL);
+}
+
+/**
+ * b_matrix_attach_h5_full: (skip)
+ * @m: #BMatrix
+ * @group_id: HDF5 group
+ * @data_name: name
+ * @storage: (nullable): storage options, or %NULL for the defaults
+ *
+ * Add a matrix to an HDF5 group.
+ **/
+void b_matrix_attach_h5_full(BMatrix * m, hid_t group_id,
+                             const gchar * data_name,
+                             const BFileStorage * storage)
 {
   g_return_if_fail(B_IS_MATRIX(m));
   g_return_if_fail(group_id != 0);
   hsize_t dims[2] = { b_matrix_get_rows(m), b_matrix_get_columns(m) };
+  const double *data = b_matrix_get_values(m);
 
+  b_hdf5_lock();
   hid_t dataspace_id = H5Screate_simple(2, dims, NULL);
-  hid_t plist_id = H5Pcreate(H5P_DATASET_CREATE);
-
-  H5Pset_chunk(plist_id, 2, dims);
-  H5Pset_deflate(plist_id, DEFLATE_LEVEL);
+  hid_t plist_id = create_dataset_plist(storage, 2, dims, NULL,
+                                        sizeof(double));
 
   hid_t id =
     H5Dcreate2(group_id, data_name, H5T_NATIVE_DOUBLE, dataspace_id,
                H5P_DEFAULT, plist_id, H5P_DEFAULT);
-  H5Dwrite(id, H5T_NATIVE_DOUBLE, dataspace_id, dataspace_id, H5P_DEFAULT,
-           b_matrix_get_values(m));
+  write_dataset(id, plist_id, H5T_NATIVE_DOUBLE, storage, 2, dims, data);
 
   H5Sclose(dataspace_id);
 
   H5Pclose(plist_id);
   H5Dclose(id);
+  b_hdf5_unlock();
 }
 
+typedef struct {
+  hid_t group_id;
+  const BFileStorage *storage;
+} SaveData;
+
+static
+void data_attach_h5(BData * d, hid_t group_id, const gchar * data_name,
+                    const BFileStorage * storage);
+
 static
 void save_func(gpointer key, gpointer value, gpointer user_data)
 {
   const gchar *name = (gchar *) key;
   g_message("save %s", name);
   BData *d = B_DATA(value);
-  hid_t *subgroup_id = (hid_t *) user_data;
-  b_data_attach_h5(d, *subgroup_id, name);
+  SaveData *sd = (SaveData *) user_data;
+  data_attach_h5(d, sd->group_id, name, sd->storage);
 }
 
 /**
@@ -260,47 +1032,44 @@ void save_func(gpointer key, gpointer value, gpointer user_data)
  * @data_name: path
  * @d: #YData
  *
- * Add a YData object to a #BFile.
+ * Add a YData object to a #BFile, with the file's storage options.
  **/
 void b_file_attach_data(BFile *f, const gchar *data_name, BData *d)
 {
   g_return_if_fail(f->write);
-  b_data_attach_h5(d,f->handle,data_name);
+  data_attach_h5(d,f->handle,data_name,&f->storage);
 }
 
-/**
- * y_data_attach_h5: (skip)
- * @d: #YData
- * @group_id: HDF5 group
- * @data_name: name
- *
- * Add a YData object to an HDF5 group.
- **/
-void b_data_attach_h5(BData * d, hid_t group_id, const gchar * data_name)
+static
+void data_attach_h5(BData * d, hid_t group_id, const gchar * data_name,
+                    const BFileStorage * storage)
 {
-  hid_t subgroup_id;
+  SaveData sd;
   g_return_if_fail(B_IS_DATA(d));
   g_return_if_fail(group_id != 0);
   char n = b_data_get_n_dimensions(d);
   switch (n) {
   case -1:
     if (data_name)
-      subgroup_id =
-        H5Gcreate(group_id, data_name, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+      sd.group_id = b_hdf5_create_group(group_id, data_name);
     else
-      subgroup_id = group_id;
-    b_struct_foreach(B_STRUCT(d), save_func, &subgroup_id);
-    if (data_name != NULL)
-      H5Gclose(subgroup_id);
+      sd.group_id = group_id;
+    sd.storage = storage;
+    b_struct_foreach(B_STRUCT(d), save_func, &sd);
+    if (data_name != NULL) {
+      b_hdf5_lock();
+      H5Gclose(sd.group_id);
+      b_hdf5_unlock();
+    }
     break;
   case 0:
     g_warning("scalar save to h5 not implemented");
     break;
   case 1:
-    b_vector_attach_h5(B_VECTOR(d), group_id, data_name);
+    b_vector_attach_h5_full(B_VECTOR(d), group_id, data_name, storage);
     break;
   case 2:
-    b_matrix_attach_h5(B_MATRIX(d), group_id, data_name);
+    b_matrix_attach_h5_full(B_MATRIX(d), group_id, data_name, storage);
     break;
   default:
     g_warning("number of dimensions %d not supported", n);
@@ -308,6 +1077,22 @@ void b_data_attach_h5(BData * d, hid_t group_id, const gchar * data_name)
   }
 }
 
+/**
+ * y_data_attach_h5: (skip)
+ * @d: #YData
+ * @group_id: HDF5 group
+ * @data_name: name
+ *
+ * Add a YData object to an HDF5 group, with the default storage options.
+ **/
+void b_data_attach_h5(BData * d, hid_t group_id, const gchar * data_name)
+{
+  data_attach_h5(d, group_id, data_name, NULL);
+}
+
+static
+BData *vector_from_h5(hid_t group_id, const gchar * data_name);
+
 /**
  * b_vector_from_h5: (skip)
  * @group_id: HDF5 group
@@ -318,6 +1103,15 @@ void b_data_attach_h5(BData * d, hid_t group_id, const gchar * data_name)
  * Returns: (transfer full): The vector.
  **/
 BData *b_vector_from_h5(hid_t group_id, const gchar * data_name)
+{
+  b_hdf5_lock();
+  BData *d = vector_from_h5(group_id, data_name);
+  b_hdf5_unlock();
+  return d;
+}
+
+static
+BData *vector_from_h5(hid_t group_id, const gchar * data_name)
 {
   g_return_val_if_fail(group_id != 0, NULL);
   htri_t exists = H5Lexists(group_id, data_name, H5P_DEFAULT);
@@ -339,14 +1133,17 @@ BData *b_vector_from_h5(hid_t group_id, const gchar * data_name)
   g_return_val_if_fail(rank == 1, NULL);
   g_return_val_if_fail(current_dims[0] > 0, NULL);
   double *d = g_new(double, current_dims[0]);
-  H5Dread(dataset_h5, H5T_NATIVE_DOUBLE, H5S_ALL, dspace_id, H5P_DEFAULT, d);
+  b_hdf5_read_doubles(dataset_h5, d);
   BData *y = b_val_vector_new(d, current_dims[0], g_free);
   H5Sclose(dspace_id);
   H5Dclose(dataset_h5);
   return y;
 }
 
-/**
+static
+BData *matrix_from_h5(hid_t group_id, const gchar * data_name);
+
+/**
  * y_matrix_from_h5: (skip)
  * @group_id: HDF5 group
  * @data_name: name
@@ -356,6 +1153,15 @@ BData *b_vector_from_h5(hid_t group_id, const gchar * data_name)
  * Returns: (transfer full): The matrix.
  **/
 BData *b_matrix_from_h5(hid_t group_id, const gchar * data_name)
+{
+  b_hdf5_lock();
+  BData *d = matrix_from_h5(group_id, data_name);
+  b_hdf5_unlock();
+  return d;
+}
+
+static
+BData *matrix_from_h5(hid_t group_id, const gchar * data_name)
 {
   g_return_val_if_fail(group_id != 0, NULL);
   htri_t exists = H5Lexists(group_id, data_name, H5P_DEFAULT);
@@ -378,7 +1184,7 @@ BData *b_matrix_from_h5(hid_t group_id, const gchar * data_name)
   g_return_val_if_fail(current_dims[0] > 0, NULL);
   g_return_val_if_fail(current_dims[1] > 0, NULL);
   double *d = g_new(double, current_dims[0] * current_dims[1]);
-  H5Dread(dataset_h5, H5T_NATIVE_DOUBLE, H5S_ALL, dspace_id, H5P_DEFAULT, d);
+  b_hdf5_read_doubles(dataset_h5, d);
   BData *y =
     b_val_matrix_new(d, current_dims[0], current_dims[1], g_free);
   H5Sclose(dspace_id);
@@ -386,6 +1192,10 @@ BData *b_matrix_from_h5(hid_t group_id, const gchar * data_name)
   return y;
 }
 
+static
+void val_vector_replace_h5(BValVector * v, hid_t group_id,
+                           const gchar * data_name);
+
 /**
  * b_val_vector_replace_h5: (skip)
  * @v: BVectorVal
@@ -396,6 +1206,15 @@ BData *b_matrix_from_h5(hid_t group_id, const gchar * data_name)
  **/
 void b_val_vector_replace_h5(BValVector * v, hid_t group_id,
                               const gchar * data_name)
+{
+  b_hdf5_lock();
+  val_vector_replace_h5(v, group_id, data_name);
+  b_hdf5_unlock();
+}
+
+static
+void val_vector_replace_h5(BValVector * v, hid_t group_id,
+                           const gchar * data_name)
 {
   g_return_if_fail(group_id != 0);
   htri_t exists = H5Lexists(group_id, data_name, H5P_DEFAULT);
@@ -415,8 +1234,1163 @@ void b_val_vector_replace_h5(BValVector * v, hid_t group_id,
   g_return_if_fail(rank == 1);
   g_return_if_fail(current_dims[0] > 0);
   double *d = g_new(double, current_dims[0]);
-  H5Dread(dataset_h5, H5T_NATIVE_DOUBLE, H5S_ALL, dspace_id, H5P_DEFAULT, d);
+  b_hdf5_read_doubles(dataset_h5, d);
   H5Sclose(dspace_id);
   H5Dclose(dataset_h5);
   b_val_vector_replace_array(v, d, current_dims[0], g_free);
 }
+
+/* Map a contiguous dataset of native doubles into memory. Returns NULL
+ * without setting @err if the dataset's layout does not allow it. */
+static
+BData *map_dataset(BFile *f, const gchar *data_name, int rank, GError **err)
+{
+  if (H5Lexists(f->handle, data_name, H5P_DEFAULT) <= 0) {
+    g_set_error(err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                "dataset not found: %s", data_name);
+    return NULL;
+  }
+  hid_t dataset = H5Dopen(f->handle, data_name, H5P_DEFAULT);
+  if (dataset < 0) {
+    g_set_error(err, G_IO_ERROR, G_IO_ERROR_FAILED,
+                "could not open dataset %s", data_name);
+    return NULL;
+  }
+  hid_t space = H5Dget_space(dataset);
+  hid_t type = H5Dget_type(dataset);
+  hid_t plist = H5Dget_create_plist(dataset);
+  hsize_t dims[2] = { 0, 1 };
+  gboolean mappable = H5Sget_simple_extent_ndims(space) == rank &&
+    H5Pget_layout(plist) == H5D_CONTIGUOUS &&
+    H5Tequal(type, H5T_NATIVE_DOUBLE) > 0;
+  if (mappable)
+    H5Sget_simple_extent_dims(space, dims, NULL);
+  /* this counts from the start of the file, user block included */
+  haddr_t offset = mappable ? H5Dget_offset(dataset) : HADDR_UNDEF;
+  gsize bytes = dims[0] * dims[1] * sizeof(double);
+  H5Pclose(plist);
+  H5Tclose(type);
+  H5Sclose(space);
+  H5Dclose(dataset);
+  /* unallocated, empty or misaligned data is read the usual way */
+  if (offset == HADDR_UNDEF || bytes == 0 || offset % sizeof(double) != 0)
+    return NULL;
+
+  if (f->write)
+    H5Fflush(f->handle, H5F_SCOPE_LOCAL);
+  ssize_t n = H5Fget_name(f->handle, NULL, 0);
+  gchar *filename = g_malloc(n + 1);
+  H5Fget_name(f->handle, filename, n + 1);
+  int fd = g_open(filename, O_RDONLY, 0);
+  if (fd < 0) {
+    g_set_error(err, G_IO_ERROR, g_io_error_from_errno(errno),
+                "could not open %s: %s", filename, g_strerror(errno));
+    g_free(filename);
+    return NULL;
+  }
+  g_free(filename);
+  /* a private writable mapping: pages are copied if the values are
+   * changed, and the file itself is never written */
+  GMappedFile *mf = g_mapped_file_new_from_fd(fd, TRUE, err);
+  close(fd);
+  if (mf == NULL)
+    return NULL;
+  if (offset + bytes > g_mapped_file_get_length(mf)) {
+    g_mapped_file_unref(mf);
+    return NULL;
+  }
+  double *values = (double *) (g_mapped_file_get_contents(mf) + offset);
+  BData *d;
+  if (rank == 1)
+    d = b_val_vector_new(values, dims[0], NULL);
+  else
+    d = b_val_matrix_new(values, dims[0], dims[1], NULL);
+  /* the mapping lasts as long as the data object */
+  g_object_set_data_full(G_OBJECT(d), "b-mapped-file", mf,
+                         (GDestroyNotify) g_mapped_file_unref);
+  return d;
+}
+
+/**
+ * b_file_map_vector:
+ * @f: a #BFile
+ * @data_name: name of a one dimensional dataset
+ * @err: (nullable): a #GError or %NULL
+ *
+ * Get a vector whose values are the dataset's bytes in the file, mapped
+ * into memory. Nothing is allocated or read up front, and other processes
+ * mapping the same file share the pages. This works for contiguous
+ * datasets of native doubles; others are read into memory as by
+ * b_vector_from_h5().
+ *
+ * The mapping is copy-on-write: changing the values copies the pages
+ * touched, and the file is never modified.
+ *
+ * Returns: (transfer full): The vector, or %NULL on error.
+ **/
+BData *b_file_map_vector(BFile *f, const gchar *data_name, GError **err)
+{
+  g_return_val_if_fail(B_IS_FILE(f), NULL);
+  g_return_val_if_fail(data_name != NULL, NULL);
+  GError *e = NULL;
+  b_hdf5_lock();
+  BData *d = map_dataset(f, data_name, 1, &e);
+  if (d == NULL && e == NULL)
+    d = b_vector_from_h5(f->handle, data_name);
+  b_hdf5_unlock();
+  if (e) {
+    g_propagate_error(err, e);
+    return NULL;
+  }
+  return d;
+}
+
+/**
+ * b_file_map_matrix:
+ * @f: a #BFile
+ * @data_name: name of a two dimensional dataset
+ * @err: (nullable): a #GError or %NULL
+ *
+ * Get a matrix whose values are the dataset's bytes in the file, mapped
+ * copy-on-write into memory, like b_file_map_vector(). Datasets that can't
+ * be mapped are read into memory as by b_matrix_from_h5().
+ *
+ * Returns: (transfer full): The matrix, or %NULL on error.
+ **/
+BData *b_file_map_matrix(BFile *f, const gchar *data_name, GError **err)
+{
+  g_return_val_if_fail(B_IS_FILE(f), NULL);
+  g_return_val_if_fail(data_name != NULL, NULL);
+  GError *e = NULL;
+  b_hdf5_lock();
+  BData *d = map_dataset(f, data_name, 2, &e);
+  if (d == NULL && e == NULL)
+    d = b_matrix_from_h5(f->handle, data_name);
+  b_hdf5_unlock();
+  if (e) {
+    g_propagate_error(err, e);
+    return NULL;
+  }
+  return d;
+}
+
+/* HDF5 type of image pixels with the given bytes, or of doubles for 0 */
+static
+hid_t image_h5_type(guchar bytes)
+{
+  switch (bytes) {
+  case 1:
+    return H5T_NATIVE_UINT8;
+  case 2:
+    return H5T_NATIVE_UINT16;
+  default:
+    return H5T_NATIVE_DOUBLE;
+  }
+}
+
+/**
+ * b_image_attach_h5: (skip)
+ * @f: a #BImage
+ * @group_id: HDF5 group
+ * @data_name: name
+ * @storage: (nullable): storage options, or %NULL for the defaults
+ *
+ * Add an image to an HDF5 group, stored as 8 or 16 bit unsigned integers
+ * like the image itself rather than as doubles.
+ **/
+void b_image_attach_h5(const BImage * f, hid_t group_id,
+                       const gchar * data_name, const BFileStorage * storage)
+{
+  g_return_if_fail(f != NULL);
+  g_return_if_fail(group_id != 0);
+  hsize_t dims[2] = { f->nrow, f->ncol };
+  if (f->data == NULL || dims[0] == 0 || dims[1] == 0) {
+    g_warning("skipping HDF5 save due to empty image");
+    return;
+  }
+  hid_t type = image_h5_type(f->bytes);
+
+  b_hdf5_lock();
+  hid_t dataspace_id = H5Screate_simple(2, dims, NULL);
+  hid_t plist_id = create_dataset_plist(storage, 2, dims, NULL, f->bytes);
+
+  hid_t id = H5Dcreate2(group_id, data_name, type, dataspace_id,
+                        H5P_DEFAULT, plist_id, H5P_DEFAULT);
+  write_dataset(id, plist_id, type, storage, 2, dims, f->data);
+
+  H5Sclose(dataspace_id);
+
+  H5Pclose(plist_id);
+  H5Dclose(id);
+  b_hdf5_unlock();
+}
+
+static
+BImage *image_from_h5(hid_t group_id, const gchar * data_name);
+
+/**
+ * b_image_from_h5: (skip)
+ * @group_id: HDF5 group
+ * @data_name: name
+ *
+ * Read an image from an HDF5 group. The dataset must be a matrix of
+ * unsigned integers of at most 16 bits, which are read without converting
+ * them to doubles. Use b_matrix_from_h5() to read it as doubles.
+ *
+ * Returns: (transfer full): The image, or %NULL.
+ **/
+BImage *b_image_from_h5(hid_t group_id, const gchar * data_name)
+{
+  b_hdf5_lock();
+  BImage *d = image_from_h5(group_id, data_name);
+  b_hdf5_unlock();
+  return d;
+}
+
+static
+BImage *image_from_h5(hid_t group_id, const gchar * data_name)
+{
+  g_return_val_if_fail(group_id != 0, NULL);
+  htri_t exists = H5Lexists(group_id, data_name, H5P_DEFAULT);
+  if (exists <= 0) {
+    return NULL;
+  }
+  hid_t dataset_h5 = H5Dopen(group_id, data_name, H5P_DEFAULT);
+  if (dataset_h5 < 0) {
+    return NULL;
+  }
+  BImage *f = NULL;
+  hid_t type_id = H5Dget_type(dataset_h5);
+  hid_t dspace_id = H5Dget_space(dataset_h5);
+  hsize_t dims[2];
+  gsize bytes = H5Tget_size(type_id);
+  if (H5Tget_class(type_id) != H5T_INTEGER || H5Tget_sign(type_id) != H5T_SGN_NONE
+      || bytes > 2) {
+    g_warning("%s is not an 8 or 16 bit unsigned dataset", data_name);
+  } else if (H5Sget_simple_extent_ndims(dspace_id) != 2) {
+    g_warning("%s is not two dimensional", data_name);
+  } else {
+    H5Sget_simple_extent_dims(dspace_id, dims, NULL);
+    f = b_image_new(bytes, dims[0], dims[1]);
+    if (f && f->data &&
+        H5Dread(dataset_h5, image_h5_type(bytes), H5S_ALL, H5S_ALL,
+                H5P_DEFAULT, f->data) < 0) {
+      b_image_free(f);
+      f = NULL;
+    }
+  }
+  H5Tclose(type_id);
+  H5Sclose(dspace_id);
+  H5Dclose(dataset_h5);
+  return f;
+}
+
+struct _BFileStream {
+  GObject base;
+  BFile *file;
+  gchar *name;
+  hid_t dataset;
+  hid_t timestamps;
+  int rank;			/* rank of one record */
+  hsize_t record_dims[2];
+  gsize record_len;		/* elements in one record */
+  guchar image_bytes;		/* bytes per pixel for images, 0 for doubles */
+  hid_t type;
+  gsize elem_size;
+  BFileStorage storage;
+  hsize_t chunk[3];
+  hsize_t buffer_records;
+  guint64 n_written;		/* records already in the file */
+  gint64 last_flush;
+  /* records waiting to be written, a few chunks' worth at most */
+  guchar *buffer;
+  gint64 *buffer_times;
+  hsize_t n_buffered;
+};
+
+G_DEFINE_TYPE (BFileStream, b_file_stream, G_TYPE_OBJECT);
+
+static
+BFileStream *file_stream_create(BFile *f, const gchar *data_name,
+                                guchar image_bytes, int rank,
+                                const hsize_t *record_dims,
+                                const BFileStorage *storage, GError **err);
+
+static
+void b_file_stream_finalize (GObject *obj)
+{
+  BFileStream *s = (BFileStream *) obj;
+  GError *err = NULL;
+  /* this may run on any thread, e.g. while a BFileWriter writes */
+  b_hdf5_lock();
+  if (!b_file_stream_flush(s, &err)) {
+    g_warning("lost %u records of %s: %s", (unsigned int) s->n_buffered,
+              s->name, err->message);
+    g_error_free(err);
+  }
+  if (s->dataset >= 0)
+    H5Dclose(s->dataset);
+  if (s->timestamps >= 0)
+    H5Dclose(s->timestamps);
+  s->file->streams = g_list_remove(s->file->streams, s);
+  b_hdf5_unlock();
+  g_clear_object(&s->file);
+  g_free(s->name);
+  g_free(s->buffer);
+  g_free(s->buffer_times);
+  G_OBJECT_CLASS(b_file_stream_parent_class)->finalize(obj);
+}
+
+static
+void b_file_stream_class_init(BFileStreamClass *class)
+{
+  GObjectClass *gobj_class = (GObjectClass *) class;
+  gobj_class->finalize = b_file_stream_finalize;
+}
+
+static
+void b_file_stream_init(BFileStream *s)
+{
+  s->dataset = -1;
+  s->timestamps = -1;
+}
+
+/* create a dataset with an unlimited first dimension, and get its chunk
+ * dimensions */
+static
+hid_t create_appendable_dataset(hid_t group_id, const gchar *name, hid_t type,
+                                int rank, const hsize_t *record_dims,
+                                const BFileStorage *storage, hsize_t *chunk)
+{
+  hsize_t dims[3] = { 0, 0, 0 };
+  hsize_t max_dims[3] = { H5S_UNLIMITED, 0, 0 };
+  int i;
+  for (i = 0; i < rank; i++) {
+    dims[i + 1] = record_dims[i];
+    max_dims[i + 1] = record_dims[i];
+  }
+  hid_t dataspace_id = H5Screate_simple(rank + 1, dims, max_dims);
+  hid_t plist_id = create_dataset_plist(storage, rank + 1, dims, max_dims,
+                                        H5Tget_size(type));
+
+  hid_t id = H5Dcreate2(group_id, name, type, dataspace_id, H5P_DEFAULT,
+                        plist_id, H5P_DEFAULT);
+  H5Pget_chunk(plist_id, rank + 1, chunk);
+  H5Sclose(dataspace_id);
+  H5Pclose(plist_id);
+  return id;
+}
+
+/* extend a stream dataset by @n records and write them after @offset */
+static
+herr_t append_records(hid_t dataset, hid_t mem_type, int rank,
+                      const hsize_t *record_dims, hsize_t offset, hsize_t n,
+                      const void *data)
+{
+  hsize_t dims[3] = { offset + n, 0, 0 };
+  hsize_t start[3] = { offset, 0, 0 };
+  hsize_t count[3] = { n, 0, 0 };
+  int i;
+  for (i = 0; i < rank; i++) {
+    dims[i + 1] = record_dims[i];
+    count[i + 1] = record_dims[i];
+  }
+  herr_t r = H5Dset_extent(dataset, dims);
+  if (r < 0)
+    return r;
+  hid_t file_space = H5Dget_space(dataset);
+  hid_t mem_space = H5Screate_simple(rank + 1, count, NULL);
+  r = H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, NULL, count,
+                          NULL);
+  if (r >= 0)
+    r = H5Dwrite(dataset, mem_type, mem_space, file_space, H5P_DEFAULT, data);
+  H5Sclose(mem_space);
+  H5Sclose(file_space);
+  return r;
+}
+
+/**
+ * b_file_stream_new: (skip)
+ * @f: a #BFile open for writing
+ * @data_name: name of the dataset
+ * @rank: rank of each record, 0 for scalars, 1 for vectors or 2 for matrices
+ * @record_dims: (array length=rank): dimensions of each record
+ * @err: (nullable): a #GError or %NULL
+ *
+ * Create a dataset in @f that grows as records are appended to it. The
+ * dataset has one more dimension than the records, and its first dimension
+ * is unlimited. The time of each record is stored in a companion dataset
+ * named "@data_name_timestamps", in microseconds since the Unix epoch, as
+ * its "units" attribute says.
+ *
+ * Records are collected in memory until a few chunks are full, and then
+ * compressed on several threads and written together, so no more than
+ * about 16 MB is held in memory. The dataset uses the storage options of
+ * @f.
+ *
+ * Returns: (transfer full): the new #BFileStream, or %NULL on error
+ **/
+BFileStream *b_file_stream_new(BFile *f, const gchar *data_name, int rank,
+                               const hsize_t *record_dims, GError **err)
+{
+  g_return_val_if_fail(B_IS_FILE(f), NULL);
+  return b_file_stream_new_full(f, data_name, rank, record_dims, &f->storage,
+                                err);
+}
+
+/**
+ * b_file_stream_new_full: (skip)
+ * @f: a #BFile open for writing
+ * @data_name: name of the dataset
+ * @rank: rank of each record, 0 for scalars, 1 for vectors or 2 for matrices
+ * @record_dims: (array length=rank): dimensions of each record
+ * @storage: storage options; the first chunk dimension counts records
+ * @err: (nullable): a #GError or %NULL
+ *
+ * Like b_file_stream_new(), but with given storage options rather than
+ * those of the file.
+ *
+ * Returns: (transfer full): the new #BFileStream, or %NULL on error
+ **/
+BFileStream *b_file_stream_new_full(BFile *f, const gchar *data_name,
+                                    int rank, const hsize_t *record_dims,
+                                    const BFileStorage *storage, GError **err)
+{
+  return file_stream_create(f, data_name, 0, rank, record_dims, storage, err);
+}
+
+/**
+ * b_file_stream_new_image: (skip)
+ * @f: a #BFile open for writing
+ * @data_name: name of the dataset
+ * @bytes: bytes per pixel, 1 or 2
+ * @nrow: number of rows in each image
+ * @ncol: number of columns in each image
+ * @err: (nullable): a #GError or %NULL
+ *
+ * Create a stream of #BImage frames stored as 8 or 16 bit unsigned
+ * integers, using the storage options of @f. Frames are appended with
+ * b_file_stream_append_image().
+ *
+ * Returns: (transfer full): the new #BFileStream, or %NULL on error
+ **/
+BFileStream *b_file_stream_new_image(BFile *f, const gchar *data_name,
+                                     guchar bytes, guint32 nrow, guint32 ncol,
+                                     GError **err)
+{
+  g_return_val_if_fail(B_IS_FILE(f), NULL);
+  g_return_val_if_fail(bytes == 1 || bytes == 2, NULL);
+  hsize_t dims[2] = { nrow, ncol };
+  return file_stream_create(f, data_name, bytes, 2, dims, &f->storage, err);
+}
+
+static
+BFileStream *file_stream_create(BFile *f, const gchar *data_name,
+                                guchar image_bytes, int rank,
+                                const hsize_t *record_dims,
+                                const BFileStorage *storage, GError **err)
+{
+  g_return_val_if_fail(B_IS_FILE(f), NULL);
+  g_return_val_if_fail(f->write, NULL);
+  g_return_val_if_fail(storage != NULL, NULL);
+  g_return_val_if_fail(data_name != NULL, NULL);
+  g_return_val_if_fail(rank >= 0 && rank <= 2, NULL);
+  g_return_val_if_fail(rank == 0 || record_dims != NULL, NULL);
+
+  gsize len = 1;
+  int i;
+  for (i = 0; i < rank; i++) {
+    if (record_dims[i] == 0) {
+      g_set_error(err, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                  "zero length record dimension for %s", data_name);
+      return NULL;
+    }
+    len *= record_dims[i];
+  }
+
+  BFileStream *s = g_object_new(B_TYPE_FILE_STREAM, NULL);
+  s->file = g_object_ref(f);
+  s->name = g_strdup(data_name);
+  s->rank = rank;
+  for (i = 0; i < rank; i++)
+    s->record_dims[i] = record_dims[i];
+  s->record_len = len;
+  s->image_bytes = image_bytes;
+  s->type = image_h5_type(image_bytes);
+  s->storage = *storage;
+  s->chunk[0] = 1;
+
+  b_hdf5_lock();
+  s->elem_size = H5Tget_size(s->type);
+  s->dataset = create_appendable_dataset(f->handle, data_name, s->type, rank,
+                                         record_dims, storage, s->chunk);
+  /* timestamps are chunked along with the records */
+  BFileStorage ts_storage = *storage;
+  hsize_t ts_chunk[1];
+  memset(ts_storage.chunk, 0, sizeof(ts_storage.chunk));
+  ts_storage.chunk[0] = s->chunk[0];
+  gchar *ts_name = g_strdup_printf("%s_timestamps", data_name);
+  if (s->dataset >= 0)
+    s->timestamps = create_appendable_dataset(f->handle, ts_name,
+                                              H5T_NATIVE_INT64, 0, NULL,
+                                              &ts_storage, ts_chunk);
+  if (s->timestamps >= 0)
+    H5LTset_attribute_string(f->handle, ts_name, "units", "microseconds since the Unix epoch");
+  f->streams = g_list_prepend(f->streams, s);
+  b_hdf5_unlock();
+  if (s->dataset < 0 || s->timestamps < 0) {
+    g_set_error(err, G_IO_ERROR, G_IO_ERROR_FAILED,
+                "could not create datasets %s and %s", data_name, ts_name);
+    g_free(ts_name);
+    g_object_unref(s);
+    return NULL;
+  }
+  g_free(ts_name);
+
+  /* hold enough whole chunks to keep the compressing threads busy */
+  gsize chunk_bytes = s->chunk[0] * len * s->elem_size;
+  gsize n_chunks = MIN(g_get_num_processors(),
+                       MAX(1, STREAM_BUFFER_BYTES / chunk_bytes));
+  s->buffer_records = s->chunk[0] * n_chunks;
+  s->buffer = g_malloc(s->buffer_records * len * s->elem_size);
+  s->buffer_times = g_new(gint64, s->buffer_records);
+  s->last_flush = g_get_monotonic_time();
+  return s;
+}
+
+static
+gboolean file_stream_push_locked(BFileStream *s, gconstpointer record,
+                                 gint64 timestamp, GError **err);
+
+/* timestamp of a frame in microseconds, like those of other records */
+static
+gint64 image_timestamp(const BImage *f)
+{
+  if (f->timestamp == 0)
+    return g_get_real_time();
+  return (gint64) (f->timestamp / 1000);
+}
+
+static
+gboolean file_stream_push(BFileStream *s, gconstpointer record,
+                          gint64 timestamp, GError **err)
+{
+  b_hdf5_lock();
+  gboolean ok = file_stream_push_locked(s, record, timestamp, err);
+  b_hdf5_unlock();
+  return ok;
+}
+
+static
+gboolean file_stream_push_locked(BFileStream *s, gconstpointer record,
+                                 gint64 timestamp, GError **err)
+{
+  /* an earlier flush failed and left the buffer full */
+  if (s->n_buffered == s->buffer_records && !b_file_stream_flush(s, err))
+    return FALSE;
+  gsize record_size = s->record_len * s->elem_size;
+  memcpy(s->buffer + s->n_buffered * record_size, record, record_size);
+  s->buffer_times[s->n_buffered] =
+    timestamp < 0 ? g_get_real_time() : timestamp;
+  s->n_buffered++;
+  if (s->n_buffered == s->buffer_records)
+    return b_file_stream_flush(s, err);
+  /* let SWMR readers see records within the flush interval */
+  if (s->file->flush_interval > 0 &&
+      g_get_monotonic_time() - s->last_flush >= s->file->flush_interval)
+    return b_file_stream_flush(s, err);
+  return TRUE;
+}
+
+/**
+ * b_file_stream_append_values: (skip)
+ * @s: a #BFileStream
+ * @values: one record, as many values as set by the record dimensions
+ * @timestamp: time of the record in microseconds, or a negative value for the current time
+ * @err: (nullable): a #GError or %NULL
+ *
+ * Append a record to the stream. The values are copied.
+ *
+ * Returns: %TRUE on success
+ **/
+gboolean b_file_stream_append_values(BFileStream *s, const double *values,
+                                     gint64 timestamp, GError **err)
+{
+  g_return_val_if_fail(B_IS_FILE_STREAM(s), FALSE);
+  g_return_val_if_fail(values != NULL, FALSE);
+  if (s->image_bytes != 0) {
+    g_set_error(err, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                "%s stores images, not doubles", s->name);
+    return FALSE;
+  }
+  return file_stream_push(s, values, timestamp, err);
+}
+
+/**
+ * b_file_stream_append_image:
+ * @s: a #BFileStream made by b_file_stream_new_image()
+ * @f: a #BImage
+ * @err: (nullable): a #GError or %NULL
+ *
+ * Append a frame to an image stream, with the frame's own timestamp,
+ * converted from nanoseconds to the microseconds since the Unix epoch used
+ * for all records.
+ * Frames with no timestamp are given the current time. The pixels are
+ * stored at their own width, without conversion.
+ *
+ * Returns: %TRUE on success
+ **/
+gboolean b_file_stream_append_image(BFileStream *s, const BImage *f,
+                                    GError **err)
+{
+  g_return_val_if_fail(B_IS_FILE_STREAM(s), FALSE);
+  g_return_val_if_fail(f != NULL, FALSE);
+  if (s->image_bytes != f->bytes || s->record_dims[0] != f->nrow ||
+      s->record_dims[1] != f->ncol) {
+    g_set_error(err, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                "image does not have the record type of %s", s->name);
+    return FALSE;
+  }
+  return file_stream_push(s, f->data, image_timestamp(f), err);
+}
+
+/**
+ * b_file_stream_append:
+ * @s: a #BFileStream
+ * @d: a #BData with the shape of one record
+ * @timestamp: time of the record in microseconds, or a negative value for the current time
+ * @err: (nullable): a #GError or %NULL
+ *
+ * Append the current values of @d to the stream.
+ *
+ * Returns: %TRUE on success
+ **/
+gboolean b_file_stream_append(BFileStream *s, BData *d, gint64 timestamp,
+                              GError **err)
+{
+  g_return_val_if_fail(B_IS_FILE_STREAM(s), FALSE);
+  g_return_val_if_fail(B_IS_DATA(d), FALSE);
+
+  gboolean match = FALSE;
+  const double *values = NULL;
+  double x;
+  switch (s->rank) {
+  case 0:
+    if ((match = B_IS_SCALAR(d))) {
+      x = b_scalar_get_value(B_SCALAR(d));
+      values = &x;
+    }
+    break;
+  case 1:
+    match = B_IS_VECTOR(d) &&
+      b_vector_get_len(B_VECTOR(d)) == s->record_dims[0];
+    if (match)
+      values = b_vector_get_values(B_VECTOR(d));
+    break;
+  case 2:
+    match = B_IS_MATRIX(d) &&
+      b_matrix_get_rows(B_MATRIX(d)) == s->record_dims[0] &&
+      b_matrix_get_columns(B_MATRIX(d)) == s->record_dims[1];
+    if (match)
+      values = b_matrix_get_values(B_MATRIX(d));
+    break;
+  }
+  if (!match) {
+    g_set_error(err, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                "data does not have the record shape of %s", s->name);
+    return FALSE;
+  }
+  return b_file_stream_append_values(s, values, timestamp, err);
+}
+
+static
+gboolean file_stream_flush(BFileStream *s, GError **err);
+
+/**
+ * b_file_stream_flush:
+ * @s: a #BFileStream
+ * @err: (nullable): a #GError or %NULL
+ *
+ * Write any records still held in memory to the file and flush it.
+ *
+ * Returns: %TRUE on success
+ **/
+gboolean b_file_stream_flush(BFileStream *s, GError **err)
+{
+  g_return_val_if_fail(B_IS_FILE_STREAM(s), FALSE);
+  b_hdf5_lock();
+  gboolean ok = file_stream_flush(s, err);
+  b_hdf5_unlock();
+  return ok;
+}
+
+static
+gboolean file_stream_flush(BFileStream *s, GError **err)
+{
+  if (s->n_buffered == 0)
+    return TRUE;
+  hsize_t dims[3] = { s->n_written + s->n_buffered, s->record_dims[0],
+    s->record_dims[1] };
+  if (H5Dset_extent(s->dataset, dims) < 0 ||
+      write_rows(s->dataset, s->type, &s->storage, s->rank + 1, dims,
+                 s->chunk, s->n_written, s->n_buffered, s->buffer) < 0 ||
+      append_records(s->timestamps, H5T_NATIVE_INT64, 0, NULL, s->n_written,
+                     s->n_buffered, s->buffer_times) < 0) {
+    g_set_error(err, G_IO_ERROR, G_IO_ERROR_FAILED,
+                "could not append to %s", s->name);
+    return FALSE;
+  }
+  s->n_written += s->n_buffered;
+  s->n_buffered = 0;
+  s->last_flush = g_get_monotonic_time();
+  H5Fflush(s->file->handle, H5F_SCOPE_LOCAL);
+  return TRUE;
+}
+
+/* flush the streams of a file in SWMR mode whose flush interval has
+ * passed */
+static
+void file_flush_streams(BFile *f)
+{
+  b_hdf5_lock();
+  gint64 now = g_get_monotonic_time();
+  GList *l;
+  for (l = f->streams; l != NULL; l = l->next) {
+    BFileStream *s = l->data;
+    GError *err = NULL;
+    if (s->n_buffered == 0 || now - s->last_flush < f->flush_interval)
+      continue;
+    if (!file_stream_flush(s, &err)) {
+      g_warning("%s", err->message);
+      g_error_free(err);
+    }
+  }
+  b_hdf5_unlock();
+}
+
+/**
+ * b_file_stream_get_n_records:
+ * @s: a #BFileStream
+ *
+ * Get the number of records appended so far, including those not yet
+ * written to the file.
+ *
+ * Returns: the number of records
+ **/
+guint64 b_file_stream_get_n_records(BFileStream *s)
+{
+  g_return_val_if_fail(B_IS_FILE_STREAM(s), 0);
+  /* a BFileWriter may be appending to the stream */
+  b_hdf5_lock();
+  guint64 n = s->n_written + s->n_buffered;
+  b_hdf5_unlock();
+  return n;
+}
+
+/* one queued write: either a record for a stream or data to attach */
+typedef struct {
+  BFileStream *stream;
+  double *values;
+  gint64 timestamp;
+  BImage *image;
+  gchar *name;
+  BData *data;
+  BFileStorage storage;
+} WriteRequest;
+
+struct _BFileWriter {
+  GObject base;
+  BFile *file;
+  GThread *thread;
+  GMutex lock;
+  GCond cond;
+  GQueue queue;
+  guint max_pending;
+  gboolean drop_when_full;
+  gboolean busy;		/* the thread is writing a request */
+  gboolean closing;
+  GError *error;		/* first error since the last sync */
+  guint64 n_written;
+  guint64 n_dropped;
+  guint64 n_waits;
+};
+
+G_DEFINE_TYPE (BFileWriter, b_file_writer, G_TYPE_OBJECT);
+
+static
+void write_request_free(WriteRequest *r)
+{
+  g_clear_object(&r->stream);
+  g_free(r->values);
+  g_clear_pointer(&r->image, b_image_free);
+  g_free(r->name);
+  g_clear_object(&r->data);
+  g_free(r);
+}
+
+static
+gpointer file_writer_thread(gpointer data)
+{
+  BFileWriter *w = (BFileWriter *) data;
+  g_mutex_lock(&w->lock);
+  while (TRUE) {
+    while (g_queue_is_empty(&w->queue) && !w->closing) {
+      gint64 interval = w->file->flush_interval;
+      if (interval == 0) {
+        g_cond_wait(&w->cond, &w->lock);
+      } else if (!g_cond_wait_until(&w->cond, &w->lock,
+                                    g_get_monotonic_time() + interval)) {
+        /* idle for a flush interval: let SWMR readers see the records */
+        g_mutex_unlock(&w->lock);
+        file_flush_streams(w->file);
+        g_mutex_lock(&w->lock);
+      }
+    }
+    WriteRequest *r = g_queue_pop_head(&w->queue);
+    if (r == NULL)
+      break;
+    w->busy = TRUE;
+    g_cond_broadcast(&w->cond);	/* there is room in the queue */
+    g_mutex_unlock(&w->lock);
+
+    GError *err = NULL;
+    b_hdf5_lock();
+    if (r->stream && r->image)
+      b_file_stream_append_image(r->stream, r->image, &err);
+    else if (r->stream)
+      b_file_stream_append_values(r->stream, r->values, r->timestamp, &err);
+    else
+      data_attach_h5(r->data, w->file->handle, r->name, &r->storage);
+    /* the last reference to a stream may be dropped here */
+    write_request_free(r);
+    b_hdf5_unlock();
+
+    g_mutex_lock(&w->lock);
+    w->busy = FALSE;
+    w->n_written++;
+    if (err) {
+      if (w->error == NULL)
+        w->error = err;
+      else
+        g_error_free(err);
+    }
+    g_cond_broadcast(&w->cond);
+  }
+  g_mutex_unlock(&w->lock);
+  return NULL;
+}
+
+static
+void b_file_writer_finalize (GObject *obj)
+{
+  BFileWriter *w = (BFileWriter *) obj;
+  /* the thread finishes everything queued before it exits */
+  g_mutex_lock(&w->lock);
+  w->closing = TRUE;
+  g_cond_broadcast(&w->cond);
+  g_mutex_unlock(&w->lock);
+  g_thread_join(w->thread);
+  if (w->error) {
+    g_warning("HDF5 writer: %s", w->error->message);
+    g_error_free(w->error);
+  }
+  g_mutex_clear(&w->lock);
+  g_cond_clear(&w->cond);
+  g_clear_object(&w->file);
+  G_OBJECT_CLASS(b_file_writer_parent_class)->finalize(obj);
+}
+
+static
+void b_file_writer_class_init(BFileWriterClass *class)
+{
+  GObjectClass *gobj_class = (GObjectClass *) class;
+  gobj_class->finalize = b_file_writer_finalize;
+}
+
+static
+void b_file_writer_init(BFileWriter *w)
+{
+  g_mutex_init(&w->lock);
+  g_cond_init(&w->cond);
+  g_queue_init(&w->queue);
+}
+
+/**
+ * b_file_writer_new:
+ * @f: a #BFile open for writing
+ * @max_pending: the most requests that can wait in the queue
+ * @drop_when_full: whether to drop requests when the queue is full, rather than wait
+ *
+ * Create a writer that does all writes to @f on its own thread. Requests
+ * take a copy of the data and return at once, unless the queue is full.
+ * Then they either wait for room or, if @drop_when_full is set, are dropped
+ * and counted, so that an acquisition callback is never held up.
+ *
+ * The writer takes the process-wide HDF5 lock (see b_hdf5_lock()) for
+ * each request, so streams can be created, appended to directly, flushed
+ * and closed on other threads while it runs, and other files can be read.
+ * Records of one stream are only kept in order if they all go through
+ * the writer.
+ *
+ * Returns: (transfer full): the new #BFileWriter
+ **/
+BFileWriter *b_file_writer_new(BFile *f, guint max_pending,
+                               gboolean drop_when_full)
+{
+  g_return_val_if_fail(B_IS_FILE(f), NULL);
+  g_return_val_if_fail(f->write, NULL);
+  g_return_val_if_fail(max_pending > 0, NULL);
+  BFileWriter *w = g_object_new(B_TYPE_FILE_WRITER, NULL);
+  w->file = g_object_ref(f);
+  w->max_pending = max_pending;
+  w->drop_when_full = drop_when_full;
+  w->thread = g_thread_new("b-file-writer", file_writer_thread, w);
+  return w;
+}
+
+static
+gboolean file_writer_push(BFileWriter *w, WriteRequest *r)
+{
+  g_mutex_lock(&w->lock);
+  if (g_queue_get_length(&w->queue) >= w->max_pending) {
+    if (w->drop_when_full) {
+      w->n_dropped++;
+      g_mutex_unlock(&w->lock);
+      write_request_free(r);
+      return FALSE;
+    }
+    w->n_waits++;
+    while (g_queue_get_length(&w->queue) >= w->max_pending)
+      g_cond_wait(&w->cond, &w->lock);
+  }
+  g_queue_push_tail(&w->queue, r);
+  g_cond_broadcast(&w->cond);
+  g_mutex_unlock(&w->lock);
+  return TRUE;
+}
+
+static
+void snapshot_func(gpointer key, gpointer value, gpointer user_data);
+
+/* copy the current values of a data object, so it can be written later */
+static
+BData *data_snapshot(BData *d)
+{
+  if (B_IS_STRUCT(d)) {
+    BStruct *s = g_object_new(B_TYPE_STRUCT, NULL);
+    b_struct_foreach(B_STRUCT(d), snapshot_func, s);
+    return B_DATA(s);
+  }
+  if (B_IS_SCALAR(d))
+    return b_val_scalar_new(b_scalar_get_value(B_SCALAR(d)));
+  if (B_IS_VECTOR(d))
+    return b_val_vector_new_copy(b_vector_get_values(B_VECTOR(d)),
+                                 b_vector_get_len(B_VECTOR(d)));
+  if (B_IS_MATRIX(d))
+    return b_val_matrix_new_copy(b_matrix_get_values(B_MATRIX(d)),
+                                 b_matrix_get_rows(B_MATRIX(d)),
+                                 b_matrix_get_columns(B_MATRIX(d)));
+  return NULL;
+}
+
+static
+void snapshot_func(gpointer key, gpointer value, gpointer user_data)
+{
+  BData *copy = data_snapshot(B_DATA(value));
+  if (copy)
+    b_struct_set_data(B_STRUCT(user_data), (const gchar *) key, copy);
+}
+
+/**
+ * b_file_writer_attach_data:
+ * @w: a #BFileWriter
+ * @data_name: (nullable): path
+ * @d: #BData
+ *
+ * Queue a copy of @d to be added to the file, like b_file_attach_data(),
+ * with the file's storage options at the time of the call.
+ *
+ * Returns: %TRUE if the request was queued, %FALSE if it was dropped
+ **/
+gboolean b_file_writer_attach_data(BFileWriter *w, const gchar *data_name,
+                                   BData *d)
+{
+  g_return_val_if_fail(B_IS_FILE_WRITER(w), FALSE);
+  g_return_val_if_fail(B_IS_DATA(d), FALSE);
+  BData *copy = data_snapshot(d);
+  g_return_val_if_fail(copy != NULL, FALSE);
+  WriteRequest *r = g_new0(WriteRequest, 1);
+  r->name = g_strdup(data_name);
+  r->data = copy;
+  r->storage = w->file->storage;
+  return file_writer_push(w, r);
+}
+
+/**
+ * b_file_writer_append:
+ * @w: a #BFileWriter
+ * @s: a #BFileStream in the writer's file
+ * @d: a #BData with the shape of one record
+ * @timestamp: time of the record in microseconds, or a negative value for the current time
+ *
+ * Queue a copy of the current values of @d to be appended to @s. Shape
+ * errors are reported by the next b_file_writer_sync().
+ *
+ * Returns: %TRUE if the request was queued, %FALSE if it was dropped
+ **/
+gboolean b_file_writer_append(BFileWriter *w, BFileStream *s, BData *d,
+                              gint64 timestamp)
+{
+  g_return_val_if_fail(B_IS_FILE_WRITER(w), FALSE);
+  g_return_val_if_fail(B_IS_FILE_STREAM(s), FALSE);
+  g_return_val_if_fail(B_IS_DATA(d), FALSE);
+  const double *values = NULL;
+  gsize len = 0;
+  double x;
+  if (B_IS_SCALAR(d)) {
+    x = b_scalar_get_value(B_SCALAR(d));
+    values = &x;
+    len = 1;
+  } else if (B_IS_VECTOR(d)) {
+    values = b_vector_get_values(B_VECTOR(d));
+    len = b_vector_get_len(B_VECTOR(d));
+  } else if (B_IS_MATRIX(d)) {
+    values = b_matrix_get_values(B_MATRIX(d));
+    len = b_matrix_get_rows(B_MATRIX(d)) * b_matrix_get_columns(B_MATRIX(d));
+  }
+  if (len != s->record_len) {
+    g_mutex_lock(&w->lock);
+    if (w->error == NULL)
+      g_set_error(&w->error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                  "data does not have the record shape of %s", s->name);
+    g_mutex_unlock(&w->lock);
+    return FALSE;
+  }
+  WriteRequest *r = g_new0(WriteRequest, 1);
+  r->stream = g_object_ref(s);
+  r->values = g_memdup(values, len * sizeof(double));
+  r->timestamp = timestamp < 0 ? g_get_real_time() : timestamp;
+  return file_writer_push(w, r);
+}
+
+/**
+ * b_file_writer_append_image:
+ * @w: a #BFileWriter
+ * @s: an image #BFileStream in the writer's file
+ * @f: a #BImage
+ *
+ * Queue a copy of @f to be appended to @s, as by
+ * b_file_stream_append_image(). A frame with no timestamp is given the
+ * time of this call. Errors are reported by the next b_file_writer_sync().
+ *
+ * Returns: %TRUE if the request was queued, %FALSE if it was dropped
+ **/
+gboolean b_file_writer_append_image(BFileWriter *w, BFileStream *s,
+                                    const BImage *f)
+{
+  g_return_val_if_fail(B_IS_FILE_WRITER(w), FALSE);
+  g_return_val_if_fail(B_IS_FILE_STREAM(s), FALSE);
+  g_return_val_if_fail(f != NULL, FALSE);
+  WriteRequest *r = g_new0(WriteRequest, 1);
+  r->stream = g_object_ref(s);
+  r->image = b_image_copy(f);
+  if (r->image->timestamp == 0)
+    r->image->timestamp = (guint64) g_get_real_time() * 1000;
+  return file_writer_push(w, r);
+}
+
+/**
+ * b_file_writer_sync:
+ * @w: a #BFileWriter
+ * @err: (nullable): a #GError or %NULL
+ *
+ * Wait until all queued requests have been written, then flush the file.
+ *
+ * Returns: %TRUE if no write failed since the last sync
+ **/
+gboolean b_file_writer_sync(BFileWriter *w, GError **err)
+{
+  g_return_val_if_fail(B_IS_FILE_WRITER(w), FALSE);
+  g_mutex_lock(&w->lock);
+  while (!g_queue_is_empty(&w->queue) || w->busy)
+    g_cond_wait(&w->cond, &w->lock);
+  GError *e = w->error;
+  w->error = NULL;
+  g_mutex_unlock(&w->lock);
+  b_hdf5_lock();
+  H5Fflush(w->file->handle, H5F_SCOPE_LOCAL);
+  b_hdf5_unlock();
+  if (e) {
+    g_propagate_error(err, e);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * b_file_writer_get_n_pending:
+ * @w: a #BFileWriter
+ *
+ * Get the number of requests waiting in the queue.
+ *
+ * Returns: the number of requests
+ **/
+guint b_file_writer_get_n_pending(BFileWriter *w)
+{
+  g_return_val_if_fail(B_IS_FILE_WRITER(w), 0);
+  g_mutex_lock(&w->lock);
+  guint n = g_queue_get_length(&w->queue);
+  g_mutex_unlock(&w->lock);
+  return n;
+}
+
+/**
+ * b_file_writer_get_n_written:
+ * @w: a #BFileWriter
+ *
+ * Get the number of requests the writer thread has completed.
+ *
+ * Returns: the number of requests
+ **/
+guint64 b_file_writer_get_n_written(BFileWriter *w)
+{
+  g_return_val_if_fail(B_IS_FILE_WRITER(w), 0);
+  g_mutex_lock(&w->lock);
+  guint64 n = w->n_written;
+  g_mutex_unlock(&w->lock);
+  return n;
+}
+
+/**
+ * b_file_writer_get_n_dropped:
+ * @w: a #BFileWriter
+ *
+ * Get the number of requests dropped because the queue was full.
+ *
+ * Returns: the number of requests
+ **/
+guint64 b_file_writer_get_n_dropped(BFileWriter *w)
+{
+  g_return_val_if_fail(B_IS_FILE_WRITER(w), 0);
+  g_mutex_lock(&w->lock);
+  guint64 n = w->n_dropped;
+  g_mutex_unlock(&w->lock);
+  return n;
+}
+
+/**
+ * b_file_writer_get_n_waits:
+ * @w: a #BFileWriter
+ *
+ * Get the number of requests that had to wait for room in the queue.
+ *
+ * Returns: the number of requests
+ **/
+guint64 b_file_writer_get_n_waits(BFileWriter *w)
+{
+  g_return_val_if_fail(B_IS_FILE_WRITER(w), 0);
+  g_mutex_lock(&w->lock);
+  guint64 n = w->n_waits;
+  g_mutex_unlock(&w->lock);
+  return n;
+}
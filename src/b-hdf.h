@@ -25,6 +25,7 @@
 #include <hdf5_hl.h>
 #include <data/b-data-class.h>
 #include <data/b-data-simple.h>
+#include <b-image.h>
 
 G_BEGIN_DECLS
 
@@ -32,24 +33,84 @@ G_DECLARE_FINAL_TYPE(BFile,b_file,B,FILE,GObject)
 
 #define B_TYPE_FILE  (b_file_get_type ())
 
+/**
+ * BFileStorage:
+ * @deflate: deflate (gzip) level from 0 to 9, 0 for no compression
+ * @shuffle: whether to shuffle bytes before compressing
+ * @fletcher32: whether to store a checksum with each chunk
+ * @chunk: chunk dimensions, or all zero to choose them from the data size
+ *
+ * How datasets are laid out and filtered in an HDF5 file.
+ **/
+typedef struct {
+  int deflate;
+  gboolean shuffle;
+  gboolean fletcher32;
+  hsize_t chunk[3];
+} BFileStorage;
+
+void b_file_storage_init(BFileStorage *storage);
+void b_file_set_storage(BFile *f, const BFileStorage *storage);
+const BFileStorage *b_file_get_storage(BFile *f);
+
 BFile * b_file_open_for_writing(const gchar * filename, gboolean overwrite, GError **err);
 BFile * b_file_open_for_reading(const gchar *filename, GError **err);
+BFile * b_file_open_for_writing_swmr(const gchar *filename, gboolean overwrite, GError **err);
+gboolean b_file_start_swmr(BFile *f, guint flush_interval, GError **err);
+BFile * b_file_open_for_reading_swmr(const gchar *filename, GError **err);
 hid_t b_file_get_handle(BFile *f);
 void b_file_attach_data(BFile *f, const gchar *data_name, BData *d);
+BData *b_file_map_vector(BFile *f, const gchar *data_name, GError **err);
+BData *b_file_map_matrix(BFile *f, const gchar *data_name, GError **err);
 
+void b_hdf5_lock(void);
+void b_hdf5_unlock(void);
 hid_t b_hdf5_create_group(hid_t id, const gchar *name);
 #define b_hdf5_close_group(id) H5Gclose(id);
+herr_t b_hdf5_read_doubles(hid_t dataset, double *out);
 
 void b_data_attach_h5(BData *d, hid_t group_id, const gchar *data_name);
 //BData *b_data_from_h5(hid_t group_id, const gchar *data_name);
 
 void b_vector_attach_h5 (BVector *v, hid_t group_id, const gchar *data_name);
+void b_vector_attach_h5_full (BVector *v, hid_t group_id, const gchar *data_name, const BFileStorage *storage);
 void b_vector_attach_attr_h5 (BVector *v, hid_t group_id, const gchar *obj_name, const gchar *attr_name);
 
 void b_matrix_attach_h5 (BMatrix *m, hid_t group_id, const gchar *data_name);
+void b_matrix_attach_h5_full (BMatrix *m, hid_t group_id, const gchar *data_name, const BFileStorage *storage);
 
 BData *b_vector_from_h5 (hid_t group_id, const gchar *data_name);
 BData *b_matrix_from_h5 (hid_t group_id, const gchar *data_name);
 void b_val_vector_replace_h5 (BValVector *v, hid_t group_id, const gchar *data_name);
 
+void b_image_attach_h5 (const BImage *f, hid_t group_id, const gchar *data_name, const BFileStorage *storage);
+BImage *b_image_from_h5 (hid_t group_id, const gchar *data_name);
+
+G_DECLARE_FINAL_TYPE(BFileStream,b_file_stream,B,FILE_STREAM,GObject)
+
+#define B_TYPE_FILE_STREAM  (b_file_stream_get_type ())
+
+BFileStream *b_file_stream_new(BFile *f, const gchar *data_name, int rank, const hsize_t *record_dims, GError **err);
+BFileStream *b_file_stream_new_full(BFile *f, const gchar *data_name, int rank, const hsize_t *record_dims, const BFileStorage *storage, GError **err);
+BFileStream *b_file_stream_new_image(BFile *f, const gchar *data_name, guchar bytes, guint32 nrow, guint32 ncol, GError **err);
+gboolean b_file_stream_append(BFileStream *s, BData *d, gint64 timestamp, GError **err);
+gboolean b_file_stream_append_values(BFileStream *s, const double *values, gint64 timestamp, GError **err);
+gboolean b_file_stream_append_image(BFileStream *s, const BImage *f, GError **err);
+gboolean b_file_stream_flush(BFileStream *s, GError **err);
+guint64 b_file_stream_get_n_records(BFileStream *s);
+
+G_DECLARE_FINAL_TYPE(BFileWriter,b_file_writer,B,FILE_WRITER,GObject)
+
+#define B_TYPE_FILE_WRITER  (b_file_writer_get_type ())
+
+BFileWriter *b_file_writer_new(BFile *f, guint max_pending, gboolean drop_when_full);
+gboolean b_file_writer_attach_data(BFileWriter *w, const gchar *data_name, BData *d);
+gboolean b_file_writer_append(BFileWriter *w, BFileStream *s, BData *d, gint64 timestamp);
+gboolean b_file_writer_append_image(BFileWriter *w, BFileStream *s, const BImage *f);
+gboolean b_file_writer_sync(BFileWriter *w, GError **err);
+guint b_file_writer_get_n_pending(BFileWriter *w);
+guint64 b_file_writer_get_n_written(BFileWriter *w);
+guint64 b_file_writer_get_n_dropped(BFileWriter *w);
+guint64 b_file_writer_get_n_waits(BFileWriter *w);
+
 G_END_DECLS
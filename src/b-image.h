@@ -31,7 +31,7 @@ typedef struct {
   guint32 ncol;
   guint32 nrow;
   gint32 num;			/* an index, e.g. to denote a buffer */
-  guint64 timestamp;		/* time stamp */
+  guint64 timestamp;		/* ns since the Unix epoch, 0 if unknown */
 } BImage;
 
 BImage *b_image_new(guchar bytes, guint32 nrow, guint32 ncol);
@@ -0,0 +1,396 @@
+/*
+ * b-line-profile-operation.c :
+ *
+ * Copyright (C) 2017 Scott O. Johnson (scojo202@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <memory.h>
+#include <math.h>
+#include "b-line-profile-operation.h"
+
+/**
+ * SECTION: b-line-profile-operation
+ * @short_description: Operation that samples a matrix along a line.
+ *
+ * This operation outputs the values of a matrix along a straight line between
+ * two points, which need not be aligned with the rows or columns. Points are
+ * given as (x, y) = (column, row). The profile can be averaged over several
+ * parallel lines one pixel apart, and values between pixels are taken from
+ * the nearest pixel or interpolated bilinearly.
+ *
+ * The pixels and weights for each sample are worked out once when the line
+ * or the matrix size changes, so each update only gathers those pixels.
+ */
+
+enum {
+  PROFILE_PROP_0,
+  PROFILE_PROP_X0,
+  PROFILE_PROP_Y0,
+  PROFILE_PROP_X1,
+  PROFILE_PROP_Y1,
+  PROFILE_PROP_WIDTH,
+  PROFILE_PROP_N_SAMPLES,
+  PROFILE_PROP_INTERPOLATION
+};
+
+struct _BLineProfileOperation {
+  BOperation base;
+  double x0, y0, x1, y1;
+  int width;
+  int n_samples;
+  int interpolation;
+};
+
+G_DEFINE_TYPE(BLineProfileOperation, b_line_profile_operation, B_TYPE_OPERATION);
+
+static void
+line_profile_operation_set_property(GObject * gobject, guint param_id,
+                                    GValue const *value, GParamSpec * pspec)
+{
+  BLineProfileOperation *sop = B_LINE_PROFILE_OPERATION(gobject);
+
+  switch (param_id) {
+  case PROFILE_PROP_X0:
+    sop->x0 = g_value_get_double(value);
+    break;
+  case PROFILE_PROP_Y0:
+    sop->y0 = g_value_get_double(value);
+    break;
+  case PROFILE_PROP_X1:
+    sop->x1 = g_value_get_double(value);
+    break;
+  case PROFILE_PROP_Y1:
+    sop->y1 = g_value_get_double(value);
+    break;
+  case PROFILE_PROP_WIDTH:
+    sop->width = g_value_get_int(value);
+    break;
+  case PROFILE_PROP_N_SAMPLES:
+    sop->n_samples = g_value_get_int(value);
+    break;
+  case PROFILE_PROP_INTERPOLATION:
+    sop->interpolation = g_value_get_int(value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
+    return;		/* NOTE : RETURN */
+  }
+}
+
+static void
+line_profile_operation_get_property(GObject * gobject, guint param_id,
+                                    GValue * value, GParamSpec * pspec)
+{
+  BLineProfileOperation *sop = B_LINE_PROFILE_OPERATION(gobject);
+
+  switch (param_id) {
+  case PROFILE_PROP_X0:
+    g_value_set_double(value, sop->x0);
+    break;
+  case PROFILE_PROP_Y0:
+    g_value_set_double(value, sop->y0);
+    break;
+  case PROFILE_PROP_X1:
+    g_value_set_double(value, sop->x1);
+    break;
+  case PROFILE_PROP_Y1:
+    g_value_set_double(value, sop->y1);
+    break;
+  case PROFILE_PROP_WIDTH:
+    g_value_set_int(value, sop->width);
+    break;
+  case PROFILE_PROP_N_SAMPLES:
+    g_value_set_int(value, sop->n_samples);
+    break;
+  case PROFILE_PROP_INTERPOLATION:
+    g_value_set_int(value, sop->interpolation);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
+    return;		/* NOTE : RETURN */
+  }
+}
+
+/* number of samples along the line: one per pixel of length unless set */
+static
+unsigned int line_profile_n_samples(BLineProfileOperation * sop)
+{
+  if (sop->n_samples > 0)
+    return sop->n_samples;
+  double len = hypot(sop->x1 - sop->x0, sop->y1 - sop->y0);
+  return (unsigned int) ceil(len) + 1;
+}
+
+static
+int line_profile_size(BOperation * op, BData * input, unsigned int *dims)
+{
+  g_return_val_if_fail(B_IS_MATRIX(input),0);
+  g_assert(dims);
+  BLineProfileOperation *sop = B_LINE_PROFILE_OPERATION(op);
+  dims[0] = line_profile_n_samples(sop);
+  return 1;
+}
+
+typedef struct {
+  BLineProfileOperation sop;
+  BMatrixSize size;
+  gboolean have_geometry;
+  unsigned int n;		/* samples along the line */
+  unsigned int taps;		/* pixels read for each sample */
+  unsigned int *index;		/* n*taps pixel offsets into the matrix */
+  double *weight;		/* n*taps weights, zero for pixels outside */
+  unsigned int *n_valid;	/* lines inside the matrix for each sample */
+  double *values;		/* n*taps gathered pixels */
+  double *output;
+} LineProfileOpData;
+
+/* does the task data have to work out pixels and weights again? */
+static
+gboolean line_profile_geometry_changed(LineProfileOpData * d,
+                                       BLineProfileOperation * sop,
+                                       BMatrixSize size)
+{
+  return !d->have_geometry || d->size.rows != size.rows ||
+    d->size.columns != size.columns || d->sop.x0 != sop->x0 ||
+    d->sop.y0 != sop->y0 || d->sop.x1 != sop->x1 || d->sop.y1 != sop->y1 ||
+    d->sop.width != sop->width || d->sop.n_samples != sop->n_samples ||
+    d->sop.interpolation != sop->interpolation;
+}
+
+static
+void line_profile_build_geometry(LineProfileOpData * d)
+{
+  BLineProfileOperation *sop = &d->sop;
+  unsigned int nrow = d->size.rows;
+  unsigned int ncol = d->size.columns;
+  unsigned int width = MAX(sop->width, 1);
+  unsigned int per_line = (sop->interpolation == PROFILE_BILINEAR) ? 4 : 1;
+  unsigned int i, l, k;
+
+  g_clear_pointer(&d->index,g_free);
+  g_clear_pointer(&d->weight,g_free);
+  g_clear_pointer(&d->n_valid,g_free);
+  g_clear_pointer(&d->values,g_free);
+  g_clear_pointer(&d->output,g_free);
+
+  d->n = line_profile_n_samples(sop);
+  d->taps = width * per_line;
+  d->index = g_new0(unsigned int, (size_t) d->n * d->taps);
+  d->weight = g_new0(double, (size_t) d->n * d->taps);
+  d->n_valid = g_new0(unsigned int, d->n);
+  d->values = g_new0(double, (size_t) d->n * d->taps);
+  d->output = g_new0(double, MAX(d->n, 1));
+
+  double dx = sop->x1 - sop->x0;
+  double dy = sop->y1 - sop->y0;
+  double len = hypot(dx, dy);
+  /* unit normal to the line, for the parallel lines */
+  double nx = (len > 0) ? -dy / len : 0.0;
+  double ny = (len > 0) ? dx / len : 0.0;
+
+  for (i = 0; i < d->n; i++) {
+    double t = (d->n > 1) ? (double) i / (d->n - 1) : 0.0;
+    unsigned int *idx = d->index + (size_t) i * d->taps;
+    double *w = d->weight + (size_t) i * d->taps;
+    for (l = 0; l < width; l++) {
+      double o = l - (width - 1) / 2.0;
+      double x = sop->x0 + t * dx + o * nx;
+      double y = sop->y0 + t * dy + o * ny;
+      k = l * per_line;
+      if (sop->interpolation == PROFILE_BILINEAR) {
+        if (x < 0 || y < 0 || x > (double) ncol - 1 || y > (double) nrow - 1)
+          continue;
+        unsigned int c0 = (unsigned int) floor(x);
+        unsigned int r0 = (unsigned int) floor(y);
+        unsigned int c1 = MIN(c0 + 1, ncol - 1);
+        unsigned int r1 = MIN(r0 + 1, nrow - 1);
+        double fx = x - c0;
+        double fy = y - r0;
+        idx[k] = r0 * ncol + c0;
+        idx[k + 1] = r0 * ncol + c1;
+        idx[k + 2] = r1 * ncol + c0;
+        idx[k + 3] = r1 * ncol + c1;
+        w[k] = (1 - fx) * (1 - fy);
+        w[k + 1] = fx * (1 - fy);
+        w[k + 2] = (1 - fx) * fy;
+        w[k + 3] = fx * fy;
+      } else {
+        double c = floor(x + 0.5);
+        double r = floor(y + 0.5);
+        if (c < 0 || r < 0 || c >= ncol || r >= nrow)
+          continue;
+        idx[k] = (unsigned int) r * ncol + (unsigned int) c;
+        w[k] = 1.0;
+      }
+      d->n_valid[i]++;
+    }
+    /* average over the lines that fall inside the matrix */
+    if (d->n_valid[i] > 1) {
+      for (k = 0; k < d->taps; k++)
+        w[k] /= d->n_valid[i];
+    }
+  }
+  d->have_geometry = TRUE;
+}
+
+static
+gpointer line_profile_op_create_data(BOperation * op, gpointer data,
+                                     BData * input)
+{
+  if (input == NULL)
+    return NULL;
+  LineProfileOpData *d;
+  if (data == NULL) {
+    d = g_new0(LineProfileOpData, 1);
+  } else {
+    d = (LineProfileOpData *) data;
+  }
+  BLineProfileOperation *sop = B_LINE_PROFILE_OPERATION(op);
+  BMatrix *mat = B_MATRIX(input);
+  BMatrixSize size = b_matrix_get_size(mat);
+  gboolean changed = line_profile_geometry_changed(d, sop, size);
+  d->sop = *sop;
+  d->size = size;
+  if (changed)
+    line_profile_build_geometry(d);
+
+  /* gather only the pixels the profile needs */
+  const double *m = b_matrix_get_values(mat);
+  size_t k, len = (size_t) d->n * d->taps;
+  if (m == NULL || size.rows == 0 || size.columns == 0) {
+    memset(d->values, 0, len * sizeof(double));
+    return d;
+  }
+  for (k = 0; k < len; k++)
+    d->values[k] = m[d->index[k]];
+  return d;
+}
+
+static
+void line_profile_op_data_free(gpointer data)
+{
+  LineProfileOpData *d = (LineProfileOpData *) data;
+  g_clear_pointer(&d->index,g_free);
+  g_clear_pointer(&d->weight,g_free);
+  g_clear_pointer(&d->n_valid,g_free);
+  g_clear_pointer(&d->values,g_free);
+  g_clear_pointer(&d->output,g_free);
+  g_free(d);
+}
+
+static
+gpointer line_profile_op(gpointer data)
+{
+  LineProfileOpData *d = (LineProfileOpData *) data;
+
+  if (d == NULL)
+    return NULL;
+
+  unsigned int i, k;
+  for (i = 0; i < d->n; i++) {
+    const double *v = d->values + (size_t) i * d->taps;
+    const double *w = d->weight + (size_t) i * d->taps;
+    double sum = 0.0;
+    for (k = 0; k < d->taps; k++)
+      sum += w[k] * v[k];
+    d->output[i] = d->n_valid[i] ? sum : NAN;
+  }
+  return d->output;
+}
+
+static void
+b_line_profile_operation_class_init(BLineProfileOperationClass * klass)
+{
+  GObjectClass *gobject_klass = (GObjectClass *) klass;
+  gobject_klass->set_property = line_profile_operation_set_property;
+  gobject_klass->get_property = line_profile_operation_get_property;
+  BOperationClass *op_klass = (BOperationClass *) klass;
+  op_klass->thread_safe = TRUE;
+  op_klass->op_size = line_profile_size;
+  op_klass->op_func = line_profile_op;
+  op_klass->op_data = line_profile_op_create_data;
+  op_klass->op_data_free = line_profile_op_data_free;
+
+  g_object_class_install_property(gobject_klass, PROFILE_PROP_X0,
+      g_param_spec_double("x0", "x0", "Column of the start of the line",
+                          -G_MAXDOUBLE, G_MAXDOUBLE, 0.0,
+                          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, PROFILE_PROP_Y0,
+      g_param_spec_double("y0", "y0", "Row of the start of the line",
+                          -G_MAXDOUBLE, G_MAXDOUBLE, 0.0,
+                          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, PROFILE_PROP_X1,
+      g_param_spec_double("x1", "x1", "Column of the end of the line",
+                          -G_MAXDOUBLE, G_MAXDOUBLE, 0.0,
+                          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, PROFILE_PROP_Y1,
+      g_param_spec_double("y1", "y1", "Row of the end of the line",
+                          -G_MAXDOUBLE, G_MAXDOUBLE, 0.0,
+                          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, PROFILE_PROP_WIDTH,
+      g_param_spec_int("width", "Width",
+                       "Number of parallel lines, one pixel apart, to average over",
+                       1, 2000000000, 1,
+                       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, PROFILE_PROP_N_SAMPLES,
+      g_param_spec_int("n-samples", "Number of samples",
+                       "Number of samples along the line, or 0 for one per pixel of length",
+                       0, 2000000000, 0,
+                       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, PROFILE_PROP_INTERPOLATION,
+      g_param_spec_int("interpolation", "Interpolation",
+                       "How to sample between pixels",
+                       PROFILE_NEAREST, PROFILE_BILINEAR, PROFILE_NEAREST,
+                       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void b_line_profile_operation_init(BLineProfileOperation * op)
+{
+  op->width = 1;
+  op->interpolation = PROFILE_NEAREST;
+}
+
+/**
+ * b_line_profile_operation_new:
+ * @x0: column of the start of the line
+ * @y0: row of the start of the line
+ * @x1: column of the end of the line
+ * @y1: row of the end of the line
+ * @width: number of parallel lines to average over
+ *
+ * Create a new line profile operation.
+ *
+ * Returns: a #BOperation
+ **/
+BOperation *b_line_profile_operation_new(double x0, double y0, double x1,
+                                         double y1, int width)
+{
+  g_return_val_if_fail(width >= 1, NULL);
+
+  BOperation *o = g_object_new(B_TYPE_LINE_PROFILE_OPERATION,
+                               "x0", x0, "y0", y0, "x1", x1, "y1", y1,
+                               "width", width, NULL);
+
+  return o;
+}
@@ -0,0 +1,41 @@
+/*
+ * b-line-profile-operation.h :
+ *
+ * Copyright (C) 2017 Scott O. Johnson (scojo202@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <data/b-data-class.h>
+#include <b-operation.h>
+
+G_BEGIN_DECLS
+
+G_DECLARE_FINAL_TYPE(BLineProfileOperation,b_line_profile_operation,B,LINE_PROFILE_OPERATION,BOperation)
+
+#define B_TYPE_LINE_PROFILE_OPERATION  (b_line_profile_operation_get_type ())
+
+enum {
+	PROFILE_NEAREST = 0,
+	PROFILE_BILINEAR = 1
+};
+
+BOperation *b_line_profile_operation_new (double x0, double y0, double x1,
+                                          double y1, int width);
+
+G_END_DECLS
@@ -22,6 +22,7 @@
 #include <string.h>
 #include <b-operation.h>
 #include <data/b-data-simple.h>
+#include <b-hdf-data.h>
 
 /**
  * SECTION: b-operation
@@ -88,6 +89,100 @@ double *b_create_input_array_from_matrix(BMatrix * input, gboolean is_new,
   return d;
 }
 
+/**
+ * b_create_input_array_from_vector_range: (skip)
+ * @input: a #BVector
+ * @start: first element to copy
+ * @len: number of elements to copy
+ * @old_len: number of elements in @old_input
+ * @old_input: (nullable): array from a previous call, reused if it has the
+ * right length
+ *
+ * Copy part of a vector into an array owned by task data.
+ *
+ * Returns: the array, or %NULL if @len is zero
+ **/
+double *b_create_input_array_from_vector_range(BVector * input,
+                                               unsigned int start,
+                                               unsigned int len,
+                                               unsigned int old_len,
+                                               double *old_input)
+{
+  double *d = old_input;
+  if (old_len != len || d == NULL) {
+    g_clear_pointer(&d, g_free);
+    if (len == 0)
+      return NULL;
+    d = g_try_new(double, len);
+    if (d == NULL)
+      return NULL;
+  }
+  g_assert(start + len <= b_vector_get_len(input));
+  if (B_IS_H5_VECTOR(input)) {
+    /* read just the range from the file */
+    b_h5_vector_get_range(B_H5_VECTOR(input), start, 1, len, d);
+    return d;
+  }
+  memcpy(d, b_vector_get_values(input) + start, len * sizeof(double));
+  return d;
+}
+
+/**
+ * b_create_input_array_from_matrix_region: (skip)
+ * @input: a #BMatrix
+ * @row: first row to copy
+ * @col: first column to copy
+ * @region: number of rows and columns to copy
+ * @old_len: number of elements in @old_input
+ * @old_input: (nullable): array from a previous call, reused if it has the
+ * right length
+ *
+ * Copy a rectangular region of a matrix into an array owned by task data,
+ * so that operations that only look at a few rows or columns do not have to
+ * copy the whole matrix. The region is stored row by row.
+ *
+ * Returns: the array, or %NULL if the region is empty
+ **/
+double *b_create_input_array_from_matrix_region(BMatrix * input,
+                                                unsigned int row,
+                                                unsigned int col,
+                                                BMatrixSize region,
+                                                unsigned int old_len,
+                                                double *old_input)
+{
+  double *d = old_input;
+  unsigned int len = region.rows * region.columns;
+  if (old_len != len || d == NULL) {
+    g_clear_pointer(&d, g_free);
+    if (len == 0)
+      return NULL;
+    d = g_try_new(double, len);
+    if (d == NULL)
+      return NULL;
+  }
+  BMatrixSize size = b_matrix_get_size(input);
+  g_assert(row + region.rows <= size.rows);
+  g_assert(col + region.columns <= size.columns);
+  if (B_IS_H5_MATRIX(input)) {
+    /* read just the region from the file */
+    b_h5_matrix_get_region(B_H5_MATRIX(input), row, col, 1, 1, region, d);
+    return d;
+  }
+  const double *m = b_matrix_get_values(input);
+  g_assert(m);
+  if (col == 0 && region.columns == size.columns) {
+    memcpy(d, m + (size_t) row * size.columns, len * sizeof(double));
+  } else {
+    unsigned int i;
+    for (i = 0; i < region.rows; i++) {
+      memcpy(d + (size_t) i * region.columns,
+             m + (size_t) (row + i) * size.columns + col,
+             region.columns * sizeof(double));
+    }
+  }
+  return d;
+}
+
 /**
  * b_data_new_from_operation :
  * @op: a #BOperation
@@ -210,3 +305,141 @@ void b_operation_update_task_data(BOperation * op, gpointer task_data,
   BOperationClass *klass = B_OPERATION_GET_CLASS(op);
   klass->op_data(op, task_data, input);
 }
+
+/**
+ * b_operation_update_task_pars:
+ * @op: a #BOperation
+ * @task_data: a pointer to the task data
+ *
+ * Update an existing task data structure after a change in the operation's
+ * parameters, keeping the copy of the input it already holds. Operations
+ * that cannot do this need the input to be copied again with
+ * b_operation_update_task_data().
+ *
+ * Returns: %TRUE if the task data was updated
+ **/
+gboolean b_operation_update_task_pars(BOperation * op, gpointer task_data)
+{
+  g_return_val_if_fail(B_IS_OPERATION(op), FALSE);
+  g_return_val_if_fail(task_data != NULL, FALSE);
+  BOperationClass *klass = B_OPERATION_GET_CLASS(op);
+  if (klass->op_data_pars == NULL)
+    return FALSE;
+  return klass->op_data_pars(op, task_data);
+}
+
+/**
+ * b_operation_get_n_jobs: (skip)
+ * @work: total amount of work, in arbitrary units (e.g. elements)
+ * @min_work: the smallest amount of work worth handing to a thread
+ *
+ * Choose how many jobs to split an operation into, so that each job gets at
+ * least @min_work units and there are no more jobs than processors.
+ *
+ * Returns: the number of jobs, at least 1
+ **/
+unsigned int b_operation_get_n_jobs(size_t work, size_t min_work)
+{
+  size_t n = (min_work > 0) ? work / min_work : 1;
+  n = MIN(n, g_get_num_processors());
+  return MAX(n, 1);
+}
+
+/* one call to b_operation_run_parallel; jobs are claimed by the calling
+ * thread and by pool threads alike, so a call made from inside a job
+ * finishes even when every pool thread is busy */
+typedef struct {
+  BParallelFunc func;
+  gpointer data;
+  unsigned int n_jobs;
+  gint next;			/* next job to claim */
+  unsigned int done;
+  gint refs;
+  GMutex lock;
+  GCond cond;
+} ParallelRun;
+
+static GThreadPool *parallel_pool;
+
+static void
+parallel_run_unref(ParallelRun * run)
+{
+  if (!g_atomic_int_dec_and_test(&run->refs))
+    return;
+  g_mutex_clear(&run->lock);
+  g_cond_clear(&run->cond);
+  g_free(run);
+}
+
+static void
+parallel_run_jobs(ParallelRun * run)
+{
+  unsigned int job;
+  while ((job = g_atomic_int_add(&run->next, 1)) < run->n_jobs) {
+    run->func(job, run->data);
+    g_mutex_lock(&run->lock);
+    run->done++;
+    if (run->done == run->n_jobs)
+      g_cond_broadcast(&run->cond);
+    g_mutex_unlock(&run->lock);
+  }
+}
+
+static void
+parallel_pool_func(gpointer data, gpointer user_data)
+{
+  ParallelRun *run = (ParallelRun *) data;
+  parallel_run_jobs(run);
+  parallel_run_unref(run);
+}
+
+static gpointer
+parallel_pool_new(gpointer data)
+{
+  unsigned int n = g_get_num_processors();
+  parallel_pool = g_thread_pool_new(parallel_pool_func, NULL,
+                                    MAX(n, 2) - 1, FALSE, NULL);
+  return parallel_pool;
+}
+
+/**
+ * b_operation_run_parallel: (skip)
+ * @n_jobs: number of jobs
+ * @func: (scope call): function to call for each job
+ * @data: data passed to @func
+ *
+ * Call @func for each job index from 0 to @n_jobs-1 on several threads and
+ * wait for all of them to finish. The calling thread runs jobs too, and the
+ * others run on a pool of threads shared by all operations, created the
+ * first time it is needed, so that operations run on every frame of a live
+ * source don't start and stop threads each time. This is meant to be called
+ * from an operation's op_func, which may itself be running in a #GTask
+ * thread.
+ **/
+void b_operation_run_parallel(unsigned int n_jobs, BParallelFunc func,
+                              gpointer data)
+{
+  static GOnce pool_once = G_ONCE_INIT;
+  g_return_if_fail(func != NULL);
+  if (n_jobs <= 1) {
+    func(0, data);
+    return;
+  }
+  g_once(&pool_once, parallel_pool_new, NULL);
+  ParallelRun *run = g_new0(ParallelRun, 1);
+  run->func = func;
+  run->data = data;
+  run->n_jobs = n_jobs;
+  run->refs = n_jobs;		/* the caller and one per pool task */
+  g_mutex_init(&run->lock);
+  g_cond_init(&run->cond);
+  unsigned int i;
+  for (i = 1; i < n_jobs; i++)
+    g_thread_pool_push(parallel_pool, run, NULL);
+  parallel_run_jobs(run);
+  g_mutex_lock(&run->lock);
+  while (run->done < run->n_jobs)
+    g_cond_wait(&run->cond, &run->lock);
+  g_mutex_unlock(&run->lock);
+  parallel_run_unref(run);
+}
@@ -41,6 +41,9 @@ G_DECLARE_DERIVABLE_TYPE(BOperation,b_operation,B,OPERATION,GObject)
  * @op_func: the function to call for the operation
  * @op_data: allocate data for the operation
  * @op_data_free: a #GDestroyNotify for the operation data
+ * @op_data_pars: optional; copy changed operation parameters into existing
+ * operation data without touching the input, returning %FALSE if the input
+ * has to be copied again
  *
  * Class for BOperation.
  **/
@@ -52,10 +55,22 @@ struct _BOperationClass {
   gpointer (*op_func) (gpointer data);
   gpointer (*op_data) (BOperation *op, gpointer data, BData *input);
   GDestroyNotify op_data_free;
+  gboolean (*op_data_pars) (BOperation *op, gpointer data);
 };
 
+/**
+ * BParallelFunc:
+ * @job: index of the job, from 0 to the number of jobs minus one
+ * @data: data passed to b_operation_run_parallel()
+ *
+ * Function run for each job by b_operation_run_parallel().
+ **/
+typedef void (*BParallelFunc) (unsigned int job, gpointer data);
+
 double *b_create_input_array_from_vector(BVector *input, gboolean is_new, unsigned int old_size, double *old_input);
 double *b_create_input_array_from_matrix(BMatrix *input, gboolean is_new, BMatrixSize old_size, double *old_input);
+double *b_create_input_array_from_vector_range(BVector *input, unsigned int start, unsigned int len, unsigned int old_len, double *old_input);
+double *b_create_input_array_from_matrix_region(BMatrix *input, unsigned int row, unsigned int col, BMatrixSize region, unsigned int old_len, double *old_input);
 
 BData *b_data_new_from_operation(BOperation *op, BData *input);
 
@@ -63,5 +78,9 @@ GTask * b_operation_get_task(BOperation *op, gpointer user_data, GAsyncReadyCall
 gpointer b_operation_create_task_data(BOperation *op, BData *input);
 void b_operation_run_task(BOperation *op, gpointer user_data, GAsyncReadyCallback cb, gpointer cb_data);
 void b_operation_update_task_data(BOperation *op, gpointer task_data, BData *input);
+gboolean b_operation_update_task_pars(BOperation *op, gpointer task_data);
+
+unsigned int b_operation_get_n_jobs(size_t work, size_t min_work);
+void b_operation_run_parallel(unsigned int n_jobs, BParallelFunc func, gpointer data);
 
 G_END_DECLS
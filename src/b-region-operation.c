@@ -0,0 +1,468 @@
+/*
+ * b-region-operation.c :
+ *
+ * Copyright (C) 2017 Scott O. Johnson (scojo202@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <memory.h>
+#include <math.h>
+#include <stdlib.h>
+#include "b-region-operation.h"
+
+/**
+ * SECTION: b-region-operation
+ * @short_description: Operation that computes statistics of regions of a matrix.
+ *
+ * This operation computes the sum, mean, count, minimum and maximum of the
+ * elements of a matrix inside each of a set of regions (rectangles,
+ * ellipses or polygons). Points are given as (x, y) = (column, row), and an
+ * element is inside a region if its (column, row) position is.
+ *
+ * The output is a matrix with one row per region, in the order they were
+ * added, and columns REGION_SUM, REGION_MEAN, REGION_COUNT, REGION_MIN and
+ * REGION_MAX. Regions with no elements inside the matrix give a count of
+ * zero and NaN for the mean, minimum and maximum.
+ *
+ * The regions are turned into runs of elements along rows once, when they or
+ * the size of the matrix change. Each update only copies the elements inside
+ * the regions, in row order, and all regions are reduced in one pass.
+ */
+
+enum {
+  REGION_PROP_0,
+  REGION_PROP_N_REGIONS
+};
+
+enum {
+  SHAPE_RECTANGLE,
+  SHAPE_ELLIPSE,
+  SHAPE_POLYGON
+};
+
+typedef struct {
+  int kind;
+  double p[4];			/* corners, or centre and radii */
+  double *x, *y;		/* polygon vertices */
+  unsigned int n;
+} Shape;
+
+struct _BRegionOperation {
+  BOperation base;
+  GArray *shapes;
+  guint generation;		/* changes whenever the shapes do */
+};
+
+G_DEFINE_TYPE(BRegionOperation, b_region_operation, B_TYPE_OPERATION);
+
+static void
+region_operation_get_property(GObject * gobject, guint param_id,
+                              GValue * value, GParamSpec * pspec)
+{
+  BRegionOperation *sop = B_REGION_OPERATION(gobject);
+
+  switch (param_id) {
+  case REGION_PROP_N_REGIONS:
+    g_value_set_uint(value, sop->shapes->len);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
+    return;		/* NOTE : RETURN */
+  }
+}
+
+static
+int region_size(BOperation * op, BData * input, unsigned int *dims)
+{
+  g_return_val_if_fail(B_IS_MATRIX(input),0);
+  g_assert(dims);
+  BRegionOperation *sop = B_REGION_OPERATION(op);
+  dims[0] = sop->shapes->len;
+  dims[1] = REGION_N_STATS;
+  return 2;
+}
+
+/* a run of elements of one row inside a region */
+typedef struct {
+  unsigned int row;
+  unsigned int c0, c1;		/* first and last column */
+  unsigned int label;
+} Span;
+
+typedef struct {
+  guint generation;
+  gboolean have_spans;
+  BMatrixSize size;
+  unsigned int n_regions;
+  GArray *spans;		/* sorted by row */
+  double *values;		/* elements of all spans, in order */
+  unsigned int n_values;
+  double *output;
+  unsigned int output_len;
+} RegionOpData;
+
+/* add the span of row r between x0 and x1, clipped to the matrix */
+static
+void region_add_span(GArray * spans, BMatrixSize size, unsigned int label,
+                     int r, double x0, double x1)
+{
+  if (r < 0 || r >= (int) size.rows)
+    return;
+  double c0 = MAX(ceil(x0), 0.0);
+  double c1 = MIN(floor(x1), (double) size.columns - 1);
+  if (c1 < c0)
+    return;
+  Span s = { r, (unsigned int) c0, (unsigned int) c1, label };
+  g_array_append_val(spans, s);
+}
+
+static
+int compare_doubles(const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+static
+void region_rasterize(Shape * s, unsigned int label, BMatrixSize size,
+                      GArray * spans)
+{
+  int r;
+  if (s->kind == SHAPE_RECTANGLE) {
+    int r0 = (int) ceil(MIN(s->p[1], s->p[3]));
+    int r1 = (int) floor(MAX(s->p[1], s->p[3]));
+    r0 = MAX(r0, 0);
+    r1 = MIN(r1, (int) size.rows - 1);
+    for (r = r0; r <= r1; r++)
+      region_add_span(spans, size, label, r, MIN(s->p[0], s->p[2]),
+                      MAX(s->p[0], s->p[2]));
+  } else if (s->kind == SHAPE_ELLIPSE) {
+    double cx = s->p[0], cy = s->p[1], rx = s->p[2], ry = s->p[3];
+    if (rx <= 0 || ry <= 0)
+      return;
+    int r0 = MAX((int) ceil(cy - ry), 0);
+    int r1 = MIN((int) floor(cy + ry), (int) size.rows - 1);
+    for (r = r0; r <= r1; r++) {
+      double dy = (r - cy) / ry;
+      double half = rx * sqrt(MAX(1.0 - dy * dy, 0.0));
+      region_add_span(spans, size, label, r, cx - half, cx + half);
+    }
+  } else if (s->kind == SHAPE_POLYGON) {
+    /* even-odd rule, sampling each row at its centre line */
+    double ymin = s->y[0], ymax = s->y[0];
+    unsigned int i, j;
+    for (i = 1; i < s->n; i++) {
+      ymin = MIN(ymin, s->y[i]);
+      ymax = MAX(ymax, s->y[i]);
+    }
+    int r0 = MAX((int) ceil(ymin), 0);
+    int r1 = MIN((int) floor(ymax), (int) size.rows - 1);
+    double *xs = g_new(double, s->n);
+    for (r = r0; r <= r1; r++) {
+      unsigned int nx = 0;
+      for (i = 0, j = s->n - 1; i < s->n; j = i++) {
+        double yi = s->y[i], yj = s->y[j];
+        if ((yi <= r && r < yj) || (yj <= r && r < yi))
+          xs[nx++] = s->x[i] + (r - yi) * (s->x[j] - s->x[i]) / (yj - yi);
+      }
+      qsort(xs, nx, sizeof(double), compare_doubles);
+      for (i = 0; i + 1 < nx; i += 2)
+        region_add_span(spans, size, label, r, xs[i], xs[i + 1]);
+    }
+    g_free(xs);
+  }
+}
+
+static
+int compare_spans(const void *a, const void *b)
+{
+  const Span *x = a, *y = b;
+  if (x->row != y->row)
+    return (x->row > y->row) - (x->row < y->row);
+  return (x->c0 > y->c0) - (x->c0 < y->c0);
+}
+
+static
+gpointer region_op_create_data(BOperation * op, gpointer data, BData * input)
+{
+  if (input == NULL)
+    return NULL;
+  RegionOpData *d;
+  if (data == NULL) {
+    d = g_new0(RegionOpData, 1);
+    d->spans = g_array_new(FALSE, FALSE, sizeof(Span));
+  } else {
+    d = (RegionOpData *) data;
+  }
+  BRegionOperation *sop = B_REGION_OPERATION(op);
+  BMatrix *mat = B_MATRIX(input);
+  BMatrixSize size = b_matrix_get_size(mat);
+  unsigned int i, k;
+
+  if (!d->have_spans || d->generation != sop->generation ||
+      d->size.rows != size.rows || d->size.columns != size.columns) {
+    g_array_set_size(d->spans, 0);
+    for (i = 0; i < sop->shapes->len; i++)
+      region_rasterize(&g_array_index(sop->shapes, Shape, i), i, size,
+                       d->spans);
+    /* visit the matrix in row order, however the regions interleave */
+    g_array_sort(d->spans, compare_spans);
+    d->n_values = 0;
+    for (k = 0; k < d->spans->len; k++) {
+      Span *s = &g_array_index(d->spans, Span, k);
+      d->n_values += s->c1 - s->c0 + 1;
+    }
+    g_clear_pointer(&d->values,g_free);
+    d->values = g_new(double, MAX(d->n_values, 1));
+    d->n_regions = sop->shapes->len;
+    d->generation = sop->generation;
+    d->size = size;
+    d->have_spans = TRUE;
+  }
+
+  unsigned int len = d->n_regions * REGION_N_STATS;
+  if (d->output_len != len || d->output == NULL) {
+    g_clear_pointer(&d->output,g_free);
+    d->output = g_new0(double, MAX(len, 1));
+    d->output_len = len;
+  }
+
+  /* copy only the elements inside regions */
+  const double *m = b_matrix_get_values(mat);
+  double *v = d->values;
+  for (k = 0; k < d->spans->len; k++) {
+    Span *s = &g_array_index(d->spans, Span, k);
+    unsigned int n = s->c1 - s->c0 + 1;
+    memcpy(v, m + (size_t) s->row * size.columns + s->c0, n * sizeof(double));
+    v += n;
+  }
+  return d;
+}
+
+static
+void region_op_data_free(gpointer data)
+{
+  RegionOpData *d = (RegionOpData *) data;
+  g_array_unref(d->spans);
+  g_clear_pointer(&d->values,g_free);
+  g_clear_pointer(&d->output,g_free);
+  g_free(d);
+}
+
+static
+gpointer region_op(gpointer data)
+{
+  RegionOpData *d = (RegionOpData *) data;
+
+  if (d == NULL)
+    return NULL;
+
+  unsigned int i, j, k;
+  double *out = d->output;
+  for (i = 0; i < d->n_regions; i++) {
+    double *o = out + (size_t) i * REGION_N_STATS;
+    o[REGION_SUM] = 0.0;
+    o[REGION_COUNT] = 0.0;
+    o[REGION_MIN] = INFINITY;
+    o[REGION_MAX] = -INFINITY;
+  }
+
+  const double *v = d->values;
+  for (k = 0; k < d->spans->len; k++) {
+    const Span *s = &g_array_index(d->spans, Span, k);
+    unsigned int n = s->c1 - s->c0 + 1;
+    double *o = out + (size_t) s->label * REGION_N_STATS;
+    double sum = 0.0, mn = o[REGION_MIN], mx = o[REGION_MAX];
+    for (j = 0; j < n; j++) {
+      sum += v[j];
+      mn = MIN(mn, v[j]);
+      mx = MAX(mx, v[j]);
+    }
+    o[REGION_SUM] += sum;
+    o[REGION_COUNT] += n;
+    o[REGION_MIN] = mn;
+    o[REGION_MAX] = mx;
+    v += n;
+  }
+
+  for (i = 0; i < d->n_regions; i++) {
+    double *o = out + (size_t) i * REGION_N_STATS;
+    if (o[REGION_COUNT] > 0) {
+      o[REGION_MEAN] = o[REGION_SUM] / o[REGION_COUNT];
+    } else {
+      o[REGION_MEAN] = NAN;
+      o[REGION_MIN] = NAN;
+      o[REGION_MAX] = NAN;
+    }
+  }
+  return out;
+}
+
+static
+void shape_clear(gpointer data)
+{
+  Shape *s = (Shape *) data;
+  g_clear_pointer(&s->x,g_free);
+  g_clear_pointer(&s->y,g_free);
+}
+
+static void region_operation_finalize(GObject * obj)
+{
+  BRegionOperation *sop = B_REGION_OPERATION(obj);
+  g_clear_pointer(&sop->shapes,g_array_unref);
+  G_OBJECT_CLASS(b_region_operation_parent_class)->finalize(obj);
+}
+
+static void b_region_operation_class_init(BRegionOperationClass * klass)
+{
+  GObjectClass *gobject_klass = (GObjectClass *) klass;
+  gobject_klass->get_property = region_operation_get_property;
+  gobject_klass->finalize = region_operation_finalize;
+  BOperationClass *op_klass = (BOperationClass *) klass;
+  op_klass->thread_safe = TRUE;
+  op_klass->op_size = region_size;
+  op_klass->op_func = region_op;
+  op_klass->op_data = region_op_create_data;
+  op_klass->op_data_free = region_op_data_free;
+
+  g_object_class_install_property(gobject_klass, REGION_PROP_N_REGIONS,
+      g_param_spec_uint("n-regions", "Number of regions",
+                        "Number of regions, one output row each",
+                        0, G_MAXUINT, 0,
+                        G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+}
+
+static void b_region_operation_init(BRegionOperation * op)
+{
+  op->shapes = g_array_new(FALSE, TRUE, sizeof(Shape));
+  g_array_set_clear_func(op->shapes, shape_clear);
+}
+
+/**
+ * b_region_operation_new:
+ *
+ * Create a new region statistics operation, with no regions.
+ *
+ * Returns: a #BOperation
+ **/
+BOperation *b_region_operation_new(void)
+{
+  return g_object_new(B_TYPE_REGION_OPERATION, NULL);
+}
+
+static
+unsigned int region_add_shape(BRegionOperation * op, Shape * s)
+{
+  g_array_append_val(op->shapes, *s);
+  op->generation++;
+  g_object_notify(G_OBJECT(op), "n-regions");
+  return op->shapes->len - 1;
+}
+
+/**
+ * b_region_operation_add_rectangle:
+ * @op: a #BRegionOperation
+ * @x0: column of one corner
+ * @y0: row of one corner
+ * @x1: column of the opposite corner
+ * @y1: row of the opposite corner
+ *
+ * Add a rectangular region, including its edges.
+ *
+ * Returns: the index of the region, i.e. its row in the output
+ **/
+unsigned int b_region_operation_add_rectangle(BRegionOperation * op,
+                                              double x0, double y0,
+                                              double x1, double y1)
+{
+  g_return_val_if_fail(B_IS_REGION_OPERATION(op), 0);
+  Shape s = { SHAPE_RECTANGLE, { x0, y0, x1, y1 }, NULL, NULL, 0 };
+  return region_add_shape(op, &s);
+}
+
+/**
+ * b_region_operation_add_ellipse:
+ * @op: a #BRegionOperation
+ * @cx: column of the centre
+ * @cy: row of the centre
+ * @rx: half the width, along the rows
+ * @ry: half the height, along the columns
+ *
+ * Add an elliptical region with axes along the rows and columns.
+ *
+ * Returns: the index of the region, i.e. its row in the output
+ **/
+unsigned int b_region_operation_add_ellipse(BRegionOperation * op,
+                                            double cx, double cy,
+                                            double rx, double ry)
+{
+  g_return_val_if_fail(B_IS_REGION_OPERATION(op), 0);
+  Shape s = { SHAPE_ELLIPSE, { cx, cy, rx, ry }, NULL, NULL, 0 };
+  return region_add_shape(op, &s);
+}
+
+/**
+ * b_region_operation_add_polygon:
+ * @op: a #BRegionOperation
+ * @x: (array length=n): columns of the vertices
+ * @y: (array length=n): rows of the vertices
+ * @n: number of vertices
+ *
+ * Add a polygonal region. Self-intersecting polygons use the even-odd rule.
+ *
+ * Returns: the index of the region, i.e. its row in the output
+ **/
+unsigned int b_region_operation_add_polygon(BRegionOperation * op,
+                                            const double *x, const double *y,
+                                            unsigned int n)
+{
+  g_return_val_if_fail(B_IS_REGION_OPERATION(op), 0);
+  g_return_val_if_fail(x != NULL && y != NULL, 0);
+  g_return_val_if_fail(n >= 3, 0);
+  Shape s = { SHAPE_POLYGON, { 0, 0, 0, 0 },
+              g_memdup(x, n * sizeof(double)),
+              g_memdup(y, n * sizeof(double)), n };
+  return region_add_shape(op, &s);
+}
+
+/**
+ * b_region_operation_clear:
+ * @op: a #BRegionOperation
+ *
+ * Remove all regions.
+ **/
+void b_region_operation_clear(BRegionOperation * op)
+{
+  g_return_if_fail(B_IS_REGION_OPERATION(op));
+  g_array_set_size(op->shapes, 0);
+  op->generation++;
+  g_object_notify(G_OBJECT(op), "n-regions");
+}
+
+/**
+ * b_region_operation_get_n_regions:
+ * @op: a #BRegionOperation
+ *
+ * Get the number of regions.
+ *
+ * Returns: the number of regions
+ **/
+unsigned int b_region_operation_get_n_regions(BRegionOperation * op)
+{
+  g_return_val_if_fail(B_IS_REGION_OPERATION(op), 0);
+  return op->shapes->len;
+}
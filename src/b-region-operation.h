@@ -0,0 +1,55 @@
+/*
+ * b-region-operation.h :
+ *
+ * Copyright (C) 2017 Scott O. Johnson (scojo202@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <data/b-data-class.h>
+#include <b-operation.h>
+
+G_BEGIN_DECLS
+
+G_DECLARE_FINAL_TYPE(BRegionOperation,b_region_operation,B,REGION_OPERATION,BOperation)
+
+#define B_TYPE_REGION_OPERATION  (b_region_operation_get_type ())
+
+enum {
+	REGION_SUM = 0,
+	REGION_MEAN,
+	REGION_COUNT,
+	REGION_MIN,
+	REGION_MAX,
+	REGION_N_STATS
+};
+
+BOperation *b_region_operation_new (void);
+unsigned int b_region_operation_add_rectangle (BRegionOperation *op,
+                                               double x0, double y0,
+                                               double x1, double y1);
+unsigned int b_region_operation_add_ellipse (BRegionOperation *op,
+                                             double cx, double cy,
+                                             double rx, double ry);
+unsigned int b_region_operation_add_polygon (BRegionOperation *op,
+                                             const double *x, const double *y,
+                                             unsigned int n);
+void b_region_operation_clear (BRegionOperation *op);
+unsigned int b_region_operation_get_n_regions (BRegionOperation *op);
+
+G_END_DECLS
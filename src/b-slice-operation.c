@@ -38,7 +38,8 @@ enum {
   SLICE_PROP_INDEX,
   SLICE_PROP_TYPE,
   SLICE_PROP_WIDTH,
-  SLICE_PROP_MEAN
+  SLICE_PROP_MEAN,
+  SLICE_PROP_INTEGRAL
 };
 
 struct _BSliceOperation {
@@ -49,6 +50,7 @@ struct _BSliceOperation {
   int index2;
   int width2;
   gboolean mean;
+  gboolean integral;
 };
 
 G_DEFINE_TYPE(BSliceOperation, b_slice_operation, B_TYPE_OPERATION);
@@ -72,6 +74,9 @@ slice_operation_set_property(GObject * gobject, guint param_id,
   case SLICE_PROP_MEAN:
     sop->mean = g_value_get_boolean(value);
     break;
+  case SLICE_PROP_INTEGRAL:
+    sop->integral = g_value_get_boolean(value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
     return;		/* NOTE : RETURN */
@@ -97,6 +102,9 @@ slice_operation_get_property(GObject * gobject, guint param_id, GValue * value,
   case SLICE_PROP_MEAN:
     g_value_set_boolean(value, sop->mean);
     break;
+  case SLICE_PROP_INTEGRAL:
+    g_value_set_boolean(value, sop->integral);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
     return;		/* NOTE : RETURN */
@@ -141,15 +149,160 @@ int slice_size(BOperation * op, BData * input, unsigned int *dims)
   return n_dims;
 }
 
+/* smallest number of input elements worth summing on a separate thread */
+#define SLICE_MIN_JOB_SAMPLES 262144
+
+/* rows summed into a block total before it is added to the output, which
+   keeps rounding errors from growing with the number of rows */
+#define SUM_BLOCK_ROWS 64
+
+/* first and last index of a band of width w around index, clipped to n
+   elements; a width of -1 means all of them */
+static
+void slice_band(int index, int w, unsigned int n, int *start, int *end)
+{
+  if (w == -1) {
+    *start = 0;
+    *end = (int) n - 1;
+  } else {
+    *start = MAX(index - w / 2, 0);
+    *end = MIN(index + w / 2, (int) n - 1);
+  }
+}
+
+/* rows and columns of the input needed for a slice, so only that part of it
+   is copied into the task data */
+static
+void slice_region(BSliceOperation * sop, BMatrixSize size,
+                  unsigned int *row, unsigned int *col, BMatrixSize * region)
+{
+  int start, end;
+  *row = 0;
+  *col = 0;
+  *region = size;
+  switch (sop->type) {
+  case SLICE_ROW:
+  case SLICE_SUMROWS:
+    if (sop->type == SLICE_ROW)
+      slice_band(sop->index, 1, size.rows, &start, &end);
+    else
+      slice_band(sop->index, sop->width, size.rows, &start, &end);
+    *row = start;
+    region->rows = MAX(end - start + 1, 0);
+    break;
+  case SLICE_COL:
+  case SLICE_SUMCOLS:
+    if (sop->type == SLICE_COL)
+      slice_band(sop->index, 1, size.columns, &start, &end);
+    else
+      slice_band(sop->index, sop->width, size.columns, &start, &end);
+    *col = start;
+    region->columns = MAX(end - start + 1, 0);
+    break;
+  default:
+    region->rows = 0;
+    region->columns = 0;
+  }
+}
+
 typedef struct {
   BSliceOperation sop;
   GType input_type;
   double *input;
-  BMatrixSize size;
+  unsigned int input_len;
+  BMatrixSize size;		/* size of the whole input */
+  unsigned int row, col;	/* first row and column of the slice */
+  BMatrixSize region;		/* part of the input copied into input */
+  double *table;		/* summed-area table, used instead of input */
+  unsigned int table_len;
   double *output;
   unsigned int output_len;
+  double *scratch;
+  /* per-job partial sums and block buffers for parallel SLICE_SUMROWS */
+  double *partial;
+  unsigned int partial_len;
+  unsigned int n_jobs;
 } SliceOpData;
 
+static
+gboolean slice_uses_table(BSliceOperation * sop)
+{
+  return sop->integral &&
+    (sop->type == SLICE_SUMROWS || sop->type == SLICE_SUMCOLS);
+}
+
+/* build the summed-area table of a matrix: element (i,j) of the table, which
+   has one more row and column than the matrix, is the sum of all elements
+   above and to the left of (i,j) */
+static
+void slice_build_table(SliceOpData * d, BMatrix * mat)
+{
+  unsigned int nrow = d->size.rows;
+  unsigned int ncol = d->size.columns;
+  unsigned int w = ncol + 1;
+  unsigned int len = (nrow + 1) * w;
+  unsigned int i, j;
+  if (d->table_len != len || d->table == NULL) {
+    g_clear_pointer(&d->table,g_free);
+    d->table = g_try_new(double, len);
+    d->table_len = d->table ? len : 0;
+    if (d->table == NULL)
+      return;
+  }
+  const double *m = b_matrix_get_values(mat);
+  g_assert(m);
+  memset(d->table, 0, w * sizeof(double));
+  for (i = 0; i < nrow; i++) {
+    const double *x = m + (size_t) i * ncol;
+    const double *prev = d->table + (size_t) i * w;
+    double *t = d->table + (size_t) (i + 1) * w;
+    double sum = 0.0;
+    t[0] = 0.0;
+    for (j = 0; j < ncol; j++) {
+      sum += x[j];
+      t[j + 1] = prev[j + 1] + sum;
+    }
+  }
+}
+
+/* allocate outputs and work buffers for the current parameters */
+static
+void slice_alloc_output(SliceOpData * d)
+{
+  unsigned int len = 0;
+  BSliceOperation *sop = &d->sop;
+  if (sop->type == SLICE_ROW || sop->type == SLICE_SUMROWS)
+    len = d->size.columns;
+  else if (sop->type == SLICE_COL || sop->type == SLICE_SUMCOLS)
+    len = d->size.rows;
+  d->n_jobs = 1;
+  if (d->table == NULL &&
+      (sop->type == SLICE_SUMROWS || sop->type == SLICE_SUMCOLS)) {
+    d->n_jobs = b_operation_get_n_jobs(d->input_len, SLICE_MIN_JOB_SAMPLES);
+    d->n_jobs = MIN(d->n_jobs, MAX(d->size.rows, 1));
+  }
+  if (sop->type == SLICE_SUMROWS && d->n_jobs > 1) {
+    unsigned int plen = 2 * d->n_jobs * len;
+    if (d->partial_len != plen) {
+      g_clear_pointer(&d->partial,g_free);
+      d->partial = g_try_new(double, plen);
+      d->partial_len = d->partial ? plen : 0;
+      if (d->partial == NULL)
+        d->n_jobs = 1;
+    }
+  }
+  if (d->output_len != len || d->scratch == NULL) {
+    g_clear_pointer(&d->output,g_free);
+    g_clear_pointer(&d->scratch,g_free);
+    d->output = g_try_new0(double, len);
+    d->scratch = g_try_new0(double, len);
+    if (d->output && d->scratch)
+      d->output_len = len;
+    else
+      d->output_len = 0;
+  }
+}
+
 static
 gpointer vector_slice_op_create_data(BOperation * op, gpointer data,
                                      BData * input)
@@ -157,11 +310,9 @@ gpointer vector_slice_op_create_data(BOperation * op, gpointer data,
   if (input == NULL)
     return NULL;
   SliceOpData *d;
-  gboolean neu = TRUE;
   if (data == NULL) {
     d = g_new0(SliceOpData, 1);
   } else {
-    neu = FALSE;
     d = (SliceOpData *) data;
   }
   BSliceOperation *sop = B_SLICE_OPERATION(op);
@@ -169,10 +320,19 @@ gpointer vector_slice_op_create_data(BOperation * op, gpointer data,
   if (B_IS_VECTOR(input)) {
     BVector *vec = B_VECTOR(input);
     d->input_type = B_TYPE_VECTOR;
-    d->input =
-      b_create_input_array_from_vector(vec, neu, d->size.columns, d->input);
     d->size.columns = b_vector_get_len(vec);
     d->size.rows = 0; /* special case for an input vector */
+    int start, end;
+    if (sop->type == SLICE_ELEMENT)
+      slice_band(sop->index, 1, d->size.columns, &start, &end);
+    else
+      slice_band(sop->index, sop->width, d->size.columns, &start, &end);
+    d->region.rows = 1;
+    d->region.columns = MAX(end - start + 1, 0);
+    d->input = b_create_input_array_from_vector_range(vec, start,
+                                                      d->region.columns,
+                                                      d->input_len, d->input);
+    d->input_len = d->input ? d->region.columns : 0;
     if (d->output_len != 1) {
       g_clear_pointer(&d->output,g_free);
       d->output = g_new0(double, 1);
@@ -182,30 +342,150 @@ gpointer vector_slice_op_create_data(BOperation * op, gpointer data,
   }
   BMatrix *mat = B_MATRIX(input);
   d->input_type = B_TYPE_MATRIX;
-  d->input = b_create_input_array_from_matrix(mat, neu, d->size, d->input);
   d->size = b_matrix_get_size(mat);
-  unsigned int dims[2];
-  slice_size(op, input, dims);
-  if (d->output_len != dims[0]) {
-    g_clear_pointer(&d->output,g_free);
-    d->output = g_try_new0(double, dims[0]);
-    if (d->output)
-      d->output_len = dims[0];
-    else
-      d->output_len = 0;
+  slice_region(sop, d->size, &d->row, &d->col, &d->region);
+  if (slice_uses_table(sop)) {
+    g_clear_pointer(&d->input,g_free);
+    d->input_len = 0;
+    slice_build_table(d, mat);
+  } else {
+    g_clear_pointer(&d->table,g_free);
+    d->table_len = 0;
+    d->input = b_create_input_array_from_matrix_region(mat, d->row, d->col,
+                                                       d->region,
+                                                       d->input_len,
+                                                       d->input);
+    if (d->input == NULL) {
+      d->region.rows = 0;
+      d->region.columns = 0;
+    }
+    d->input_len = d->region.rows * d->region.columns;
   }
+  slice_alloc_output(d);
   return d;
 }
 
+/* with a summed-area table, a new index or width only needs the slice
+   parameters; everything else needs the input again */
+static
+gboolean vector_slice_op_update_pars(BOperation * op, gpointer data)
+{
+  SliceOpData *d = (SliceOpData *) data;
+  BSliceOperation *sop = B_SLICE_OPERATION(op);
+  if (d->input_type != B_TYPE_MATRIX || d->table == NULL ||
+      !slice_uses_table(sop))
+    return FALSE;
+  d->sop = *sop;
+  slice_region(sop, d->size, &d->row, &d->col, &d->region);
+  slice_alloc_output(d);
+  return TRUE;
+}
+
 static
 void vector_slice_op_data_free(gpointer d)
 {
   SliceOpData *s = (SliceOpData *) d;
   g_clear_pointer(&s->input,g_free);
   g_clear_pointer(&s->output,g_free);
+  g_clear_pointer(&s->scratch,g_free);
+  g_clear_pointer(&s->partial,g_free);
+  g_clear_pointer(&s->table,g_free);
   g_free(d);
 }
 
+/* sum of n contiguous elements, with several accumulators so that additions
+   can be pipelined and vectorized */
+static
+double sum_contiguous(const double *restrict x, unsigned int n)
+{
+  double s0 = 0., s1 = 0., s2 = 0., s3 = 0.;
+  double s4 = 0., s5 = 0., s6 = 0., s7 = 0.;
+  unsigned int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    s0 += x[i];
+    s1 += x[i + 1];
+    s2 += x[i + 2];
+    s3 += x[i + 3];
+    s4 += x[i + 4];
+    s5 += x[i + 5];
+    s6 += x[i + 6];
+    s7 += x[i + 7];
+  }
+  for (; i < n; i++)
+    s0 += x[i];
+  return ((s0 + s1) + (s2 + s3)) + ((s4 + s5) + (s6 + s7));
+}
+
+/* add rows start to end of m into v, streaming along rows */
+static
+void add_rows(const double *restrict m, unsigned int ncol, int start,
+              int end, double *restrict v)
+{
+  unsigned int j;
+  int k = start;
+  for (; k + 3 <= end; k += 4) {
+    const double *restrict r0 = m + (size_t) k * ncol;
+    const double *restrict r1 = r0 + ncol;
+    const double *restrict r2 = r1 + ncol;
+    const double *restrict r3 = r2 + ncol;
+    for (j = 0; j < ncol; j++)
+      v[j] += (r0[j] + r1[j]) + (r2[j] + r3[j]);
+  }
+  for (; k <= end; k++) {
+    const double *restrict r = m + (size_t) k * ncol;
+    for (j = 0; j < ncol; j++)
+      v[j] += r[j];
+  }
+}
+
+/* sum rows start to end of m into v, a block of rows at a time */
+static
+void sum_rows(const double *m, unsigned int ncol, int start, int end,
+              double *restrict v, double *restrict block)
+{
+  unsigned int j;
+  int k;
+  memset(v, 0, ncol * sizeof(double));
+  for (k = start; k <= end; k += SUM_BLOCK_ROWS) {
+    int block_end = MIN(k + SUM_BLOCK_ROWS - 1, end);
+    memset(block, 0, ncol * sizeof(double));
+    add_rows(m, ncol, k, block_end, block);
+    for (j = 0; j < ncol; j++)
+      v[j] += block[j];
+  }
+}
+
+/* rows of the region handled by a job */
+static
+void slice_job_rows(SliceOpData * d, unsigned int job, unsigned int nrow,
+                    unsigned int *first, unsigned int *last)
+{
+  *first = (unsigned int) (((size_t) nrow * job) / d->n_jobs);
+  *last = (unsigned int) (((size_t) nrow * (job + 1)) / d->n_jobs);
+}
+
+static
+void sum_rows_job(unsigned int job, gpointer data)
+{
+  SliceOpData *d = (SliceOpData *) data;
+  unsigned int ncol = d->size.columns;
+  unsigned int first, last;
+  double *partial = d->partial + (size_t) 2 * job * ncol;
+  slice_job_rows(d, job, d->region.rows, &first, &last);
+  sum_rows(d->input, ncol, first, (int) last - 1, partial, partial + ncol);
+}
+
+static
+void sum_cols_job(unsigned int job, gpointer data)
+{
+  SliceOpData *d = (SliceOpData *) data;
+  unsigned int n = d->region.columns;
+  unsigned int first, last, j;
+  slice_job_rows(d, job, d->size.rows, &first, &last);
+  for (j = first; j < last; j++)
+    d->output[j] = sum_contiguous(d->input + (size_t) j * n, n);
+}
+
 static
 gpointer vector_slice_op(gpointer input)
 {
@@ -216,88 +496,83 @@ gpointer vector_slice_op(gpointer input)
 
   unsigned int nrow = d->size.rows;
   unsigned int ncol = d->size.columns;
-  double *m = d->input;
+  double *m = d->input;		/* only the region needed for the slice */
 
   double *v = d->output;
 
   if (d->input_type == B_TYPE_VECTOR) {	/* output will be scalar */
+    unsigned int n = d->region.columns;
     if (d->sop.type == SLICE_ELEMENT) {
-      *v = m[d->sop.index];
+      *v = (n > 0) ? m[0] : NAN;
     } else if (d->sop.type == SLICE_SUMELEMENTS) {
-    unsigned int j;
-    int w = d->sop.width;
-    int start = d->sop.index - w / 2;
-    start = MAX(start, 0);
-    int end = d->sop.index + w / 2;
-    end = MIN(end, (int)(nrow - 1));
-      *v = 0.;
-      int n = 0;
-      for (j = start; j <= end; j++) {
-        *v += m[j];
-        n++;
-      }
+      *v = sum_contiguous(m, n);
       if (d->sop.mean) {
         *v /= n;
       }
     }
   } else {		/* output will be vector */
     if (d->sop.type == SLICE_ROW) {
-      memcpy(v, &m[d->sop.index * ncol], sizeof(double) * ncol);
+      if (d->region.rows == 1)
+        memcpy(v, m, sizeof(double) * ncol);
+      else
+        memset(v, 0, sizeof(double) * ncol);
     } else if (d->sop.type == SLICE_COL) {
       unsigned int j;
       for (j = 0; j < nrow; j++) {
-        v[j] = m[d->sop.index + j * ncol];
-      }
-    } else if (d->sop.type == SLICE_SUMROWS) {
-      int w = d->sop.width;
-      int start, end;
-      if(w==-1) {
-        start = 0;
-        end = nrow-1;
-      }
-      else {
-        start = d->sop.index - w / 2;
-        start = MAX(start, 0);
-        end = d->sop.index + w / 2;
-        end = MIN(end, (int)(nrow - 1));
+        v[j] = (d->region.columns == 1) ? m[j] : 0.0;
       }
+    } else if (d->table && d->sop.type == SLICE_SUMROWS) {
+      unsigned int n = d->region.rows;
+      unsigned int w = ncol + 1;
+      const double *t0 = d->table + (size_t) d->row * w;
+      const double *t1 = t0 + (size_t) n * w;
       unsigned int j;
-      int k;
       for (j = 0; j < ncol; j++) {
-        int n = 0;
-        v[j] = 0.;
-        for (k = start; k <= end; k++) {
-          v[j] += m[j + k * ncol];
-          n++;
-        }
+        v[j] = (t1[j + 1] - t0[j + 1]) - (t1[j] - t0[j]);
         if (d->sop.mean)
           v[j] /= n;
       }
-    } else if (d->sop.type == SLICE_SUMCOLS) {
-      int w = d->sop.width;
-      int start,end;
-      if(w==-1) {
-        start=0;
-        end=ncol-1;
-      }
-      else {
-        start = d->sop.index - w / 2;
-        start = MAX(start, 0);
-        end = d->sop.index + w / 2;
-        end = MIN(end, (int)(ncol - 1));
-      }
+    } else if (d->table && d->sop.type == SLICE_SUMCOLS) {
+      unsigned int n = d->region.columns;
+      unsigned int w = ncol + 1;
+      unsigned int c0 = d->col, c1 = d->col + n;
       unsigned int j;
-      int k;
       for (j = 0; j < nrow; j++) {
-        int n = 0;
-        v[j] = 0.;
-        for (k = start; k <= end; k++) {
-          v[j] += m[k + j * ncol];
-          n++;
-        }
+        const double *t0 = d->table + (size_t) j * w;
+        const double *t1 = t0 + w;
+        v[j] = (t1[c1] - t1[c0]) - (t0[c1] - t0[c0]);
         if (d->sop.mean)
           v[j] /= n;
       }
+    } else if (d->sop.type == SLICE_SUMROWS) {
+      unsigned int n = d->region.rows;
+      if (d->n_jobs > 1) {
+        /* each job sums a band of rows; the partial sums are added in job
+           order so the result does not depend on thread timing */
+        unsigned int i, j;
+        b_operation_run_parallel(d->n_jobs, sum_rows_job, d);
+        memcpy(v, d->partial, ncol * sizeof(double));
+        for (i = 1; i < d->n_jobs; i++) {
+          const double *p = d->partial + (size_t) 2 * i * ncol;
+          for (j = 0; j < ncol; j++)
+            v[j] += p[j];
+        }
+      } else {
+        sum_rows(m, ncol, 0, (int) n - 1, v, d->scratch);
+      }
+      if (d->sop.mean) {
+        unsigned int j;
+        for (j = 0; j < ncol; j++)
+          v[j] /= n;
+      }
+    } else if (d->sop.type == SLICE_SUMCOLS) {
+      unsigned int n = d->region.columns;
+      unsigned int j;
+      b_operation_run_parallel(d->n_jobs, sum_cols_job, d);
+      if (d->sop.mean) {
+        for (j = 0; j < nrow; j++)
+          v[j] /= n;
+      }
     }
   }
   return v;
@@ -314,6 +589,7 @@ static void b_slice_operation_class_init(BSliceOperationClass * slice_klass)
   op_klass->op_func = vector_slice_op;
   op_klass->op_data = vector_slice_op_create_data;
   op_klass->op_data_free = vector_slice_op_data_free;
+  op_klass->op_data_pars = vector_slice_op_update_pars;
 
   g_object_class_install_property(gobject_klass, SLICE_PROP_INDEX,
       g_param_spec_int("index", "Index", "Index of slice",
@@ -334,6 +610,11 @@ static void b_slice_operation_class_init(BSliceOperationClass * slice_klass)
       g_param_spec_boolean("mean", "average over elements",
                       "Average over elements if TRUE, sum over them if FALSE.",
                       FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, SLICE_PROP_INTEGRAL,
+      g_param_spec_boolean("integral", "use summed-area table",
+                      "For sums over rows or columns of a matrix, keep a summed-area table of the input so that changing the index or width does not go back to the input. Sums are then differences of large partial sums and slightly less precise.",
+                      FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void b_slice_operation_init(BSliceOperation * slice)
@@ -385,3 +666,438 @@ void b_slice_operation_set_pars(BSliceOperation * d, int type, int index,
   if (d->width != width)
     g_object_set(d, "width", width, NULL);
 }
+
+/****************************************************************************/
+
+/**
+ * BMultiSliceOperation:
+ *
+ * Operation that takes several slices of a matrix or vector at once, yielding
+ * a matrix with one row per slice (or a vector, for vector input). The
+ * indices can be a range, set with the "start", "step" and "count"
+ * properties, or an arbitrary list set with
+ * b_multi_slice_operation_set_indices(). The input is read in a single pass
+ * however many slices there are.
+ **/
+
+enum {
+  MSLICE_PROP_0,
+  MSLICE_PROP_TYPE,
+  MSLICE_PROP_START,
+  MSLICE_PROP_STEP,
+  MSLICE_PROP_COUNT,
+  MSLICE_PROP_WIDTH,
+  MSLICE_PROP_MEAN
+};
+
+struct _BMultiSliceOperation {
+  BOperation base;
+  guchar type;
+  int start;
+  int step;
+  int width;
+  gboolean mean;
+  int *indices;
+  unsigned int n_indices;
+};
+
+G_DEFINE_TYPE(BMultiSliceOperation, b_multi_slice_operation, B_TYPE_OPERATION);
+
+static
+void multi_slice_set_range(BMultiSliceOperation * sop, unsigned int count)
+{
+  unsigned int k;
+  g_clear_pointer(&sop->indices,g_free);
+  sop->n_indices = count;
+  if (count > 0)
+    sop->indices = g_new(int, count);
+  for (k = 0; k < count; k++)
+    sop->indices[k] = sop->start + (int) k * sop->step;
+}
+
+static void
+multi_slice_operation_set_property(GObject * gobject, guint param_id,
+                                   GValue const *value, GParamSpec * pspec)
+{
+  BMultiSliceOperation *sop = B_MULTI_SLICE_OPERATION(gobject);
+
+  switch (param_id) {
+  case MSLICE_PROP_TYPE:
+    sop->type = g_value_get_int(value);
+    break;
+  case MSLICE_PROP_START:
+    sop->start = g_value_get_int(value);
+    multi_slice_set_range(sop, sop->n_indices);
+    break;
+  case MSLICE_PROP_STEP:
+    sop->step = g_value_get_int(value);
+    multi_slice_set_range(sop, sop->n_indices);
+    break;
+  case MSLICE_PROP_COUNT:
+    multi_slice_set_range(sop, g_value_get_int(value));
+    break;
+  case MSLICE_PROP_WIDTH:
+    sop->width = g_value_get_int(value);
+    break;
+  case MSLICE_PROP_MEAN:
+    sop->mean = g_value_get_boolean(value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
+    return;		/* NOTE : RETURN */
+  }
+}
+
+static void
+multi_slice_operation_get_property(GObject * gobject, guint param_id,
+                                   GValue * value, GParamSpec * pspec)
+{
+  BMultiSliceOperation *sop = B_MULTI_SLICE_OPERATION(gobject);
+
+  switch (param_id) {
+  case MSLICE_PROP_TYPE:
+    g_value_set_int(value, sop->type);
+    break;
+  case MSLICE_PROP_START:
+    g_value_set_int(value, sop->start);
+    break;
+  case MSLICE_PROP_STEP:
+    g_value_set_int(value, sop->step);
+    break;
+  case MSLICE_PROP_COUNT:
+    g_value_set_int(value, sop->n_indices);
+    break;
+  case MSLICE_PROP_WIDTH:
+    g_value_set_int(value, sop->width);
+    break;
+  case MSLICE_PROP_MEAN:
+    g_value_set_boolean(value, sop->mean);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
+    return;		/* NOTE : RETURN */
+  }
+}
+
+static
+int multi_slice_size(BOperation * op, BData * input, unsigned int *dims)
+{
+  g_return_val_if_fail(B_IS_DATA(input),0);
+  g_assert(dims);
+  BMultiSliceOperation *sop = B_MULTI_SLICE_OPERATION(op);
+
+  g_assert(!B_IS_SCALAR(input));
+  g_assert(!B_IS_STRUCT(input));
+
+  dims[0] = sop->n_indices;
+  if (B_IS_VECTOR(input)) {
+    if (sop->type != SLICE_ELEMENT && sop->type != SLICE_SUMELEMENTS)
+      g_warning ("Only SLICE_ELEMENT supported for vector input.");
+    return 1;
+  }
+
+  BMatrix *mat = B_MATRIX(input);
+
+  if ((sop->type == SLICE_ROW) || (sop->type == SLICE_SUMROWS)) {
+    dims[1] = b_matrix_get_columns(mat);
+  } else if ((sop->type == SLICE_COL) || (sop->type == SLICE_SUMCOLS)) {
+    dims[1] = b_matrix_get_rows(mat);
+  } else {
+    dims[1] = 0;
+  }
+  return 2;
+}
+
+typedef struct {
+  BMultiSliceOperation sop;	/* indices are not used from this copy */
+  GType input_type;
+  unsigned int n;
+  int *band;			/* first and last index of each slice */
+  double *input;
+  unsigned int input_len;
+  BMatrixSize size;		/* size of the whole input */
+  unsigned int row, col;	/* position of the region in the input */
+  BMatrixSize region;		/* part of the input covered by any slice */
+  double *output;
+  unsigned int output_len;
+} MultiSliceOpData;
+
+static
+gpointer multi_slice_op_create_data(BOperation * op, gpointer data,
+                                    BData * input)
+{
+  if (input == NULL)
+    return NULL;
+  MultiSliceOpData *d;
+  if (data == NULL) {
+    d = g_new0(MultiSliceOpData, 1);
+  } else {
+    d = (MultiSliceOpData *) data;
+  }
+  BMultiSliceOperation *sop = B_MULTI_SLICE_OPERATION(op);
+  d->sop = *sop;
+
+  unsigned int len, n_out, k;
+  gboolean rows;
+  if (B_IS_VECTOR(input)) {
+    d->input_type = B_TYPE_VECTOR;
+    d->size.columns = b_vector_get_len(B_VECTOR(input));
+    d->size.rows = 0;	/* special case for an input vector */
+    rows = FALSE;
+    n_out = 1;
+  } else {
+    d->input_type = B_TYPE_MATRIX;
+    d->size = b_matrix_get_size(B_MATRIX(input));
+    rows = (sop->type == SLICE_ROW || sop->type == SLICE_SUMROWS);
+    n_out = rows ? d->size.columns : d->size.rows;
+  }
+  len = rows ? d->size.rows : d->size.columns;
+
+  /* bands of all slices, and the smallest region covering them */
+  if (d->n != sop->n_indices) {
+    g_clear_pointer(&d->band,g_free);
+    d->n = sop->n_indices;
+    d->band = g_new(int, 2 * MAX(d->n, 1));
+  }
+  int w = (sop->type == SLICE_ROW || sop->type == SLICE_COL) ? 1 : sop->width;
+  int first = (int) len, last = -1;
+  for (k = 0; k < d->n; k++) {
+    int *b = d->band + 2 * k;
+    slice_band(sop->indices[k], w, len, &b[0], &b[1]);
+    if (b[1] >= b[0]) {
+      first = MIN(first, b[0]);
+      last = MAX(last, b[1]);
+    }
+  }
+  unsigned int span = (last >= first) ? last - first + 1 : 0;
+
+  if (d->input_type == B_TYPE_VECTOR) {
+    d->row = 0;
+    d->col = span ? first : 0;
+    d->region.rows = 1;
+    d->region.columns = span;
+    d->input = b_create_input_array_from_vector_range(B_VECTOR(input), d->col,
+                                                      span, d->input_len,
+                                                      d->input);
+  } else {
+    d->region = d->size;
+    d->row = 0;
+    d->col = 0;
+    if (rows) {
+      d->row = span ? first : 0;
+      d->region.rows = span;
+    } else {
+      d->col = span ? first : 0;
+      d->region.columns = span;
+    }
+    d->input = b_create_input_array_from_matrix_region(B_MATRIX(input),
+                                                       d->row, d->col,
+                                                       d->region,
+                                                       d->input_len,
+                                                       d->input);
+  }
+  if (d->input == NULL) {
+    d->region.rows = 0;
+    d->region.columns = 0;
+  }
+  d->input_len = d->region.rows * d->region.columns;
+
+  if (d->output_len != d->n * n_out || d->output == NULL) {
+    g_clear_pointer(&d->output,g_free);
+    d->output = g_try_new0(double, MAX(d->n * n_out, 1));
+    d->output_len = d->output ? d->n * n_out : 0;
+  }
+  return d;
+}
+
+static
+void multi_slice_op_data_free(gpointer data)
+{
+  MultiSliceOpData *d = (MultiSliceOpData *) data;
+  g_clear_pointer(&d->band,g_free);
+  g_clear_pointer(&d->input,g_free);
+  g_clear_pointer(&d->output,g_free);
+  g_free(d);
+}
+
+static
+gpointer multi_slice_op(gpointer data)
+{
+  MultiSliceOpData *d = (MultiSliceOpData *) data;
+
+  if (d == NULL || d->output == NULL)
+    return NULL;
+
+  unsigned int nrow = d->size.rows;
+  unsigned int ncol = d->size.columns;
+  const double *m = d->input;
+  double *out = d->output;
+  unsigned int k;
+  guchar type = d->sop.type;
+
+  if (d->input_type == B_TYPE_VECTOR) {
+    for (k = 0; k < d->n; k++) {
+      const int *b = d->band + 2 * k;
+      int n = b[1] - b[0] + 1;
+      if (n <= 0) {
+        out[k] = (type == SLICE_ELEMENT) ? NAN : 0.0;
+        continue;
+      }
+      out[k] = sum_contiguous(m + b[0] - d->col, n);
+      if (type == SLICE_SUMELEMENTS && d->sop.mean)
+        out[k] /= n;
+    }
+  } else if (type == SLICE_ROW || type == SLICE_SUMROWS) {
+    /* add each row of the region into every slice that contains it, so
+       every row is read once while it is in cache */
+    unsigned int i, j;
+    memset(out, 0, d->output_len * sizeof(double));
+    for (i = 0; i < d->region.rows; i++) {
+      int r = d->row + i;
+      const double *restrict x = m + (size_t) i * ncol;
+      for (k = 0; k < d->n; k++) {
+        const int *b = d->band + 2 * k;
+        if (r < b[0] || r > b[1])
+          continue;
+        double *restrict o = out + (size_t) k * ncol;
+        for (j = 0; j < ncol; j++)
+          o[j] += x[j];
+      }
+    }
+    if (type == SLICE_SUMROWS && d->sop.mean) {
+      for (k = 0; k < d->n; k++) {
+        const int *b = d->band + 2 * k;
+        double *o = out + (size_t) k * ncol;
+        int n = b[1] - b[0] + 1;
+        for (j = 0; j < ncol; j++)
+          o[j] /= n;
+      }
+    }
+  } else if (type == SLICE_COL || type == SLICE_SUMCOLS) {
+    unsigned int j;
+    unsigned int stride = d->region.columns;
+    memset(out, 0, d->output_len * sizeof(double));
+    for (j = 0; j < d->region.rows; j++) {
+      const double *x = m + (size_t) j * stride;
+      for (k = 0; k < d->n; k++) {
+        const int *b = d->band + 2 * k;
+        int n = b[1] - b[0] + 1;
+        if (n <= 0)
+          continue;
+        double v = sum_contiguous(x + b[0] - d->col, n);
+        if (type == SLICE_SUMCOLS && d->sop.mean)
+          v /= n;
+        out[(size_t) k * nrow + j] = v;
+      }
+    }
+  }
+  return out;
+}
+
+static void multi_slice_operation_finalize(GObject * obj)
+{
+  BMultiSliceOperation *sop = B_MULTI_SLICE_OPERATION(obj);
+  g_clear_pointer(&sop->indices,g_free);
+  G_OBJECT_CLASS(b_multi_slice_operation_parent_class)->finalize(obj);
+}
+
+static void
+b_multi_slice_operation_class_init(BMultiSliceOperationClass * slice_klass)
+{
+  GObjectClass *gobject_klass = (GObjectClass *) slice_klass;
+  gobject_klass->set_property = multi_slice_operation_set_property;
+  gobject_klass->get_property = multi_slice_operation_get_property;
+  gobject_klass->finalize = multi_slice_operation_finalize;
+  BOperationClass *op_klass = (BOperationClass *) slice_klass;
+  op_klass->thread_safe = TRUE;
+  op_klass->op_size = multi_slice_size;
+  op_klass->op_func = multi_slice_op;
+  op_klass->op_data = multi_slice_op_create_data;
+  op_klass->op_data_free = multi_slice_op_data_free;
+
+  g_object_class_install_property(gobject_klass, MSLICE_PROP_TYPE,
+      g_param_spec_int("type", "Type", "Type of slicing operation",
+                        SLICE_ROW, SLICE_SUMCOLS, SLICE_ROW,
+                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, MSLICE_PROP_START,
+      g_param_spec_int("start", "Start", "Index of first slice",
+                        0, 2000000000, 0,
+                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, MSLICE_PROP_STEP,
+      g_param_spec_int("step", "Step", "Spacing between slice indices",
+                        1, 2000000000, 1,
+                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, MSLICE_PROP_COUNT,
+      g_param_spec_int("count", "Count", "Number of slices",
+                        0, 2000000000, 0,
+                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, MSLICE_PROP_WIDTH,
+      g_param_spec_int("width", "Width", "Width of each slice, if appropriate",
+                        -1, 2000000000, 1,
+                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, MSLICE_PROP_MEAN,
+      g_param_spec_boolean("mean", "average over elements",
+                      "Average over elements if TRUE, sum over them if FALSE.",
+                      FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void b_multi_slice_operation_init(BMultiSliceOperation * slice)
+{
+  slice->type = SLICE_ROW;
+  slice->step = 1;
+  slice->width = 1;
+}
+
+/**
+ * b_multi_slice_operation_new:
+ * @type: the type of slice
+ * @start: the index of the first slice
+ * @step: the spacing between slices
+ * @count: the number of slices
+ * @width: the width over which to sum or average
+ *
+ * Create a new operation taking @count slices at indices @start, @start +
+ * @step, ...
+ *
+ * Returns: a #BOperation
+ **/
+BOperation *b_multi_slice_operation_new(int type, int start, int step,
+                                        int count, int width)
+{
+  g_return_val_if_fail(start >= 0, NULL);
+  g_return_val_if_fail(step >= 1, NULL);
+  g_return_val_if_fail(count >= 0, NULL);
+  g_return_val_if_fail(width >= -1, NULL);
+
+  BOperation *o = g_object_new(B_TYPE_MULTI_SLICE_OPERATION, "type", type,
+                               "start", start, "step", step,
+                               "width", width, "count", count, NULL);
+
+  return o;
+}
+
+/**
+ * b_multi_slice_operation_set_indices:
+ * @op: a #BMultiSliceOperation
+ * @indices: (array length=n): indices of the slices
+ * @n: number of slices
+ *
+ * Set an arbitrary list of slice indices, replacing any range set through
+ * the "start", "step" and "count" properties.
+ **/
+void b_multi_slice_operation_set_indices(BMultiSliceOperation * op,
+                                         const int *indices, unsigned int n)
+{
+  g_return_if_fail(B_IS_MULTI_SLICE_OPERATION(op));
+  g_return_if_fail(indices != NULL || n == 0);
+  g_clear_pointer(&op->indices,g_free);
+  op->n_indices = n;
+  if (n > 0)
+    op->indices = g_memdup(indices, n * sizeof(int));
+  g_object_notify(G_OBJECT(op), "count");
+}
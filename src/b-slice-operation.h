@@ -44,5 +44,14 @@ BOperation *b_slice_operation_new (int type, int index, int width);
 void b_slice_operation_set_pars(BSliceOperation *d, int type, int index,
                                  int width);
 
+G_DECLARE_FINAL_TYPE(BMultiSliceOperation,b_multi_slice_operation,B,MULTI_SLICE_OPERATION,BOperation)
+
+#define B_TYPE_MULTI_SLICE_OPERATION  (b_multi_slice_operation_get_type ())
+
+BOperation *b_multi_slice_operation_new (int type, int start, int step,
+                                         int count, int width);
+void b_multi_slice_operation_set_indices (BMultiSliceOperation *op,
+                                          const int *indices, unsigned int n);
+
 
 G_END_DECLS
@@ -0,0 +1,447 @@
+/*
+ * b-stats-operation.c :
+ *
+ * Copyright (C) 2017 Scott O. Johnson (scojo202@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <memory.h>
+#include <math.h>
+#include "b-stats-operation.h"
+#include "b-data-derived.h"
+#include "data/b-struct.h"
+
+/**
+ * SECTION: b-stats-operation
+ * @short_description: Operation that computes statistics along rows or columns.
+ *
+ * This operation reduces a matrix along one axis, computing any of the
+ * minimum, maximum, position of the minimum and maximum, mean, standard
+ * deviation and RMS in a single pass. With axis STATS_ROWS the statistics
+ * are taken over the rows, giving one value per column (like
+ * SLICE_SUMROWS); with STATS_COLUMNS they are taken over the columns,
+ * giving one value per row. A vector input is reduced to one value per
+ * statistic.
+ *
+ * The output is a matrix with one row per requested statistic, in the order
+ * of the STATS_ enumeration. b_stats_struct_new() wraps it in a #BStruct of
+ * vectors. The standard deviation is the population standard deviation.
+ */
+
+enum {
+  STATS_PROP_0,
+  STATS_PROP_AXIS,
+  STATS_PROP_STATISTICS
+};
+
+struct _BStatsOperation {
+  BOperation base;
+  int axis;
+  guint statistics;
+};
+
+G_DEFINE_TYPE(BStatsOperation, b_stats_operation, B_TYPE_OPERATION);
+
+static void
+stats_operation_set_property(GObject * gobject, guint param_id,
+                             GValue const *value, GParamSpec * pspec)
+{
+  BStatsOperation *sop = B_STATS_OPERATION(gobject);
+
+  switch (param_id) {
+  case STATS_PROP_AXIS:
+    sop->axis = g_value_get_int(value);
+    break;
+  case STATS_PROP_STATISTICS:
+    sop->statistics = g_value_get_uint(value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
+    return;		/* NOTE : RETURN */
+  }
+}
+
+static void
+stats_operation_get_property(GObject * gobject, guint param_id,
+                             GValue * value, GParamSpec * pspec)
+{
+  BStatsOperation *sop = B_STATS_OPERATION(gobject);
+
+  switch (param_id) {
+  case STATS_PROP_AXIS:
+    g_value_set_int(value, sop->axis);
+    break;
+  case STATS_PROP_STATISTICS:
+    g_value_set_uint(value, sop->statistics);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
+    return;		/* NOTE : RETURN */
+  }
+}
+
+static
+unsigned int stats_count(guint statistics)
+{
+  unsigned int n = 0;
+  int s;
+  for (s = STATS_MIN; s <= STATS_RMS; s++) {
+    if (statistics & STATS_COMPONENT(s))
+      n++;
+  }
+  return n;
+}
+
+static
+int stats_size(BOperation * op, BData * input, unsigned int *dims)
+{
+  g_return_val_if_fail(B_IS_DATA(input),0);
+  g_assert(dims);
+  BStatsOperation *sop = B_STATS_OPERATION(op);
+
+  g_assert(!B_IS_SCALAR(input));
+  g_assert(!B_IS_STRUCT(input));
+
+  dims[0] = stats_count(sop->statistics);
+  if (B_IS_VECTOR(input)) {
+    dims[1] = 1;
+  } else if (sop->axis == STATS_ROWS) {
+    dims[1] = b_matrix_get_columns(B_MATRIX(input));
+  } else {
+    dims[1] = b_matrix_get_rows(B_MATRIX(input));
+  }
+  return 2;
+}
+
+typedef struct {
+  BStatsOperation sop;
+  double *input;
+  BMatrixSize size;		/* a vector is stored as a single row */
+  gboolean is_vector;
+  unsigned int len;		/* number of values of each statistic */
+  double *output;
+  unsigned int output_len;
+  /* running values for STATS_ROWS: sum, sum of squares, sums of
+     deviations from the first row and their squares, min and max */
+  double *work;
+  unsigned int work_len;
+} StatsOpData;
+
+static
+gpointer stats_op_create_data(BOperation * op, gpointer data, BData * input)
+{
+  if (input == NULL)
+    return NULL;
+  StatsOpData *d;
+  gboolean neu = TRUE;
+  if (data == NULL) {
+    d = g_new0(StatsOpData, 1);
+  } else {
+    neu = FALSE;
+    d = (StatsOpData *) data;
+  }
+  BStatsOperation *sop = B_STATS_OPERATION(op);
+  d->sop = *sop;
+  if (B_IS_VECTOR(input)) {
+    BVector *vec = B_VECTOR(input);
+    d->input = b_create_input_array_from_vector(vec, neu, d->size.columns,
+                                                d->input);
+    d->size.rows = 1;
+    d->size.columns = b_vector_get_len(vec);
+    d->is_vector = TRUE;
+    d->len = 1;
+  } else {
+    BMatrix *mat = B_MATRIX(input);
+    BMatrixSize old = d->size;
+    if (!neu && d->input == NULL)
+      neu = TRUE;
+    d->input = b_create_input_array_from_matrix(mat, neu, old, d->input);
+    d->size = b_matrix_get_size(mat);
+    d->is_vector = FALSE;
+    d->len = (sop->axis == STATS_ROWS) ? d->size.columns : d->size.rows;
+  }
+  if (d->input == NULL) {
+    d->size.rows = 0;
+    d->size.columns = 0;
+  }
+  unsigned int len = stats_count(sop->statistics) * d->len;
+  if (d->output_len != len || d->output == NULL) {
+    g_clear_pointer(&d->output,g_free);
+    d->output = g_try_new0(double, MAX(len, 1));
+    d->output_len = d->output ? len : 0;
+  }
+  if (sop->axis == STATS_ROWS && d->work_len != 6 * d->len) {
+    g_clear_pointer(&d->work,g_free);
+    d->work = g_try_new(double, 6 * MAX(d->len, 1));
+    d->work_len = d->work ? 6 * d->len : 0;
+  }
+  return d;
+}
+
+static
+void stats_op_data_free(gpointer data)
+{
+  StatsOpData *d = (StatsOpData *) data;
+  g_clear_pointer(&d->input,g_free);
+  g_clear_pointer(&d->output,g_free);
+  g_clear_pointer(&d->work,g_free);
+  g_free(d);
+}
+
+/* the output row for each statistic, or NULL if it wasn't requested */
+static
+void stats_rows(StatsOpData * d, double **rows)
+{
+  unsigned int n = 0;
+  int s;
+  for (s = STATS_MIN; s <= STATS_RMS; s++) {
+    if (d->sop.statistics & STATS_COMPONENT(s))
+      rows[s] = d->output + (size_t) (n++) * d->len;
+    else
+      rows[s] = NULL;
+  }
+}
+
+/* store statistics for output element j from n values */
+static
+void stats_finish(double **r, unsigned int j, unsigned int n, double sum,
+                  double sumsq, double dev, double devsq)
+{
+  if (r[STATS_MEAN])
+    r[STATS_MEAN][j] = sum / n;
+  if (r[STATS_STD]) {
+    /* deviations are taken from a sample value, which avoids cancellation
+       when the mean is large compared with the spread */
+    double var = (devsq - dev * dev / n) / n;
+    r[STATS_STD][j] = sqrt(MAX(var, 0.0));
+  }
+  if (r[STATS_RMS])
+    r[STATS_RMS][j] = sqrt(sumsq / n);
+}
+
+/* statistics of each contiguous run of ncol values (a row) */
+static
+void stats_along_rows(StatsOpData * d, double **r)
+{
+  unsigned int nrow = d->size.rows;
+  unsigned int ncol = d->size.columns;
+  unsigned int i, j;
+  for (i = 0; i < nrow; i++) {
+    const double *x = d->input + (size_t) i * ncol;
+    double mn = x[0], mx = x[0];
+    unsigned int imn = 0, imx = 0;
+    double k = x[0];
+    double sum = 0.0, sumsq = 0.0, dev = 0.0, devsq = 0.0;
+    for (j = 0; j < ncol; j++) {
+      double v = x[j];
+      double e = v - k;
+      sum += v;
+      sumsq += v * v;
+      dev += e;
+      devsq += e * e;
+      if (v < mn) {
+        mn = v;
+        imn = j;
+      }
+      if (v > mx) {
+        mx = v;
+        imx = j;
+      }
+    }
+    if (r[STATS_MIN])
+      r[STATS_MIN][i] = mn;
+    if (r[STATS_MAX])
+      r[STATS_MAX][i] = mx;
+    if (r[STATS_ARGMIN])
+      r[STATS_ARGMIN][i] = imn;
+    if (r[STATS_ARGMAX])
+      r[STATS_ARGMAX][i] = imx;
+    stats_finish(r, i, ncol, sum, sumsq, dev, devsq);
+  }
+}
+
+/* statistics of each column, streaming through the rows once */
+static
+void stats_over_rows(StatsOpData * d, double **r)
+{
+  unsigned int nrow = d->size.rows;
+  unsigned int ncol = d->size.columns;
+  unsigned int i, j;
+  double *sum = d->work;
+  double *sumsq = sum + ncol;
+  double *dev = sumsq + ncol;
+  double *devsq = dev + ncol;
+  double *mn = devsq + ncol;
+  double *mx = mn + ncol;
+  double *imn = r[STATS_ARGMIN];
+  double *imx = r[STATS_ARGMAX];
+  const double *k = d->input;	/* first row, the reference for deviations */
+
+  memset(d->work, 0, 4 * ncol * sizeof(double));
+  memcpy(mn, k, ncol * sizeof(double));
+  memcpy(mx, k, ncol * sizeof(double));
+  if (imn)
+    memset(imn, 0, ncol * sizeof(double));
+  if (imx)
+    memset(imx, 0, ncol * sizeof(double));
+
+  for (i = 0; i < nrow; i++) {
+    const double *restrict x = d->input + (size_t) i * ncol;
+    for (j = 0; j < ncol; j++) {
+      double v = x[j];
+      double e = v - k[j];
+      sum[j] += v;
+      sumsq[j] += v * v;
+      dev[j] += e;
+      devsq[j] += e * e;
+    }
+    for (j = 0; j < ncol; j++) {
+      if (x[j] < mn[j]) {
+        mn[j] = x[j];
+        if (imn)
+          imn[j] = i;
+      }
+      if (x[j] > mx[j]) {
+        mx[j] = x[j];
+        if (imx)
+          imx[j] = i;
+      }
+    }
+  }
+  if (r[STATS_MIN])
+    memcpy(r[STATS_MIN], mn, ncol * sizeof(double));
+  if (r[STATS_MAX])
+    memcpy(r[STATS_MAX], mx, ncol * sizeof(double));
+  for (j = 0; j < ncol; j++)
+    stats_finish(r, j, nrow, sum[j], sumsq[j], dev[j], devsq[j]);
+}
+
+static
+gpointer stats_op(gpointer data)
+{
+  StatsOpData *d = (StatsOpData *) data;
+
+  if (d == NULL || d->output == NULL)
+    return NULL;
+
+  double *r[STATS_RMS + 1];
+  stats_rows(d, r);
+
+  if (d->size.rows == 0 || d->size.columns == 0) {
+    unsigned int i;
+    for (i = 0; i < d->output_len; i++)
+      d->output[i] = NAN;
+    return d->output;
+  }
+
+  if (d->is_vector) {
+    stats_along_rows(d, r);
+  } else if (d->sop.axis == STATS_ROWS) {
+    g_return_val_if_fail(d->work != NULL, NULL);
+    stats_over_rows(d, r);
+  } else {
+    stats_along_rows(d, r);
+  }
+  return d->output;
+}
+
+static void b_stats_operation_class_init(BStatsOperationClass * klass)
+{
+  GObjectClass *gobject_klass = (GObjectClass *) klass;
+  gobject_klass->set_property = stats_operation_set_property;
+  gobject_klass->get_property = stats_operation_get_property;
+  BOperationClass *op_klass = (BOperationClass *) klass;
+  op_klass->thread_safe = TRUE;
+  op_klass->op_size = stats_size;
+  op_klass->op_func = stats_op;
+  op_klass->op_data = stats_op_create_data;
+  op_klass->op_data_free = stats_op_data_free;
+
+  g_object_class_install_property(gobject_klass, STATS_PROP_AXIS,
+      g_param_spec_int("axis", "Axis",
+                       "Whether to reduce over rows (STATS_ROWS) or columns (STATS_COLUMNS)",
+                       STATS_ROWS, STATS_COLUMNS, STATS_ROWS,
+                       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, STATS_PROP_STATISTICS,
+      g_param_spec_uint("statistics", "Statistics",
+                        "Bitmask of statistics to compute, one output row each",
+                        1, STATS_COMPONENTS_ALL,
+                        STATS_COMPONENT(STATS_MEAN),
+                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void b_stats_operation_init(BStatsOperation * op)
+{
+  op->axis = STATS_ROWS;
+  op->statistics = STATS_COMPONENT(STATS_MEAN);
+}
+
+/**
+ * b_stats_operation_new:
+ * @axis: STATS_ROWS or STATS_COLUMNS
+ * @statistics: the statistics to compute, e.g.
+ *   STATS_COMPONENT(STATS_MAX) | STATS_COMPONENT(STATS_ARGMAX)
+ *
+ * Create a new statistics operation.
+ *
+ * Returns: a #BOperation
+ **/
+BOperation *b_stats_operation_new(int axis, guint statistics)
+{
+  g_return_val_if_fail(statistics != 0, NULL);
+  g_return_val_if_fail(statistics <= STATS_COMPONENTS_ALL, NULL);
+
+  BOperation *o = g_object_new(B_TYPE_STATS_OPERATION, "axis", axis,
+                               "statistics", statistics, NULL);
+
+  return o;
+}
+
+static const gchar *stats_names[] = {
+  "min", "max", "argmin", "argmax", "mean", "std", "rms"
+};
+
+/**
+ * b_stats_struct_new:
+ * @input: the input matrix or vector
+ * @axis: STATS_ROWS or STATS_COLUMNS
+ * @statistics: the statistics to compute
+ *
+ * Create a #BStruct holding a vector for each requested statistic of @input,
+ * named "min", "max", "argmin", "argmax", "mean", "std" and "rms". All of
+ * them are computed in one pass each time the input changes.
+ *
+ * Returns: (transfer full): a #BStruct
+ **/
+BData *b_stats_struct_new(BData * input, int axis, guint statistics)
+{
+  g_return_val_if_fail(B_IS_DATA(input), NULL);
+  g_return_val_if_fail(statistics != 0, NULL);
+  g_return_val_if_fail(statistics <= STATS_COMPONENTS_ALL, NULL);
+
+  BOperation *op = b_stats_operation_new(axis, statistics);
+  const gchar *names[STATS_RMS + 2];
+  unsigned int n = 0;
+  int s;
+  for (s = STATS_MIN; s <= STATS_RMS; s++) {
+    if (statistics & STATS_COMPONENT(s))
+      names[n++] = stats_names[s];
+  }
+  names[n] = NULL;
+  return b_derived_struct_new(input, op, names);
+}
@@ -23,6 +23,7 @@
 #include <math.h>
 #include "b-subset-operation.h"
 #include "data/b-struct.h"
+#include "b-hdf-data.h"
 
 /**
  * SECTION: b-subset-operation
@@ -30,6 +31,11 @@
  *
  * These output a subset of the input array. The output is smaller in size but has the same number of dimensions.
  *
+ * The first index runs along a vector or along the columns of a matrix, the
+ * second along the rows. The lengths are the extent of the input covered;
+ * with a step greater than one only every step'th element of that is taken,
+ * which decimates the subset, e.g. for plotting.
+ *
  *
  */
 
@@ -39,13 +45,15 @@ enum {
   SUBSET_PROP_LENGTH1,
   SUBSET_PROP_START2,
   SUBSET_PROP_LENGTH2,
+  SUBSET_PROP_STEP1,
+  SUBSET_PROP_STEP2,
   N_PROPERTIES
 };
 
 struct _BSubsetOperation {
   BOperation base;
   int start1, length1, start2, length2;
-  /* stride */
+  int step1, step2;
 };
 
 G_DEFINE_TYPE(BSubsetOperation, b_subset_operation, B_TYPE_OPERATION);
@@ -69,6 +77,12 @@ subset_operation_set_property(GObject * gobject, guint param_id,
   case SUBSET_PROP_LENGTH2:
     sop->length2 = g_value_get_int(value);
     break;
+  case SUBSET_PROP_STEP1:
+    sop->step1 = g_value_get_int(value);
+    break;
+  case SUBSET_PROP_STEP2:
+    sop->step2 = g_value_get_int(value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
     return;		/* NOTE : RETURN */
@@ -94,12 +108,28 @@ subset_operation_get_property(GObject * gobject, guint param_id,
   case SUBSET_PROP_LENGTH2:
     g_value_set_int(value, sop->length2);
     break;
+  case SUBSET_PROP_STEP1:
+    g_value_set_int(value, sop->step1);
+    break;
+  case SUBSET_PROP_STEP2:
+    g_value_set_int(value, sop->step2);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
     return;		/* NOTE : RETURN */
   }
 }
 
+/* number of output elements along an axis with n input elements */
+static
+unsigned int subset_count(int start, int length, int step, unsigned int n)
+{
+  if (start < 0 || (unsigned int) start >= n || length <= 0)
+    return 0;
+  unsigned int span = MIN((unsigned int) length, n - start);
+  return (span + step - 1) / MAX(step, 1);
+}
+
 static
 int subset_size(BOperation * op, BData * input, unsigned int *dims)
 {
@@ -112,7 +142,7 @@ int subset_size(BOperation * op, BData * input, unsigned int *dims)
 
   if (B_IS_VECTOR(input)) {
     unsigned int l = b_vector_get_len(B_VECTOR(input));
-    dims[0] = (sop->start1 + sop->length1 > l) ? l - sop->start1 : sop->length1;
+    dims[0] = subset_count(sop->start1, sop->length1, sop->step1, l);
     n_dims = 1;
     return n_dims;
   }
@@ -120,26 +150,21 @@ int subset_size(BOperation * op, BData * input, unsigned int *dims)
   BMatrix *mat = B_MATRIX(input);
 
   BMatrixSize size = b_matrix_get_size(B_MATRIX(mat));
-  int real_length1 =
-      (sop->start1 + sop->length1 >
-        size.columns) ? size.columns - sop->start1 : sop->length1;
-  int real_length2 =
-      (sop->start2 + sop->length2 >
-        size.rows) ? size.rows - sop->start2 : sop->length2;
-
-  dims[0] = real_length2;
-  dims[1] = real_length1;
+
+  dims[0] = subset_count(sop->start2, sop->length2, sop->step2, size.rows);
+  dims[1] = subset_count(sop->start1, sop->length1, sop->step1, size.columns);
   n_dims = 2;
 
   return n_dims;
 }
 
+/* The subset is gathered straight from the input when the task data is
+   updated, so only the output is ever copied, however large the input. */
 typedef struct {
   BSubsetOperation sop;
-  double *input;
-  BMatrixSize size;
+  BMatrixSize output_size;	/* rows is 0 for a vector */
   double *output;
-  BMatrixSize output_size;
+  unsigned int output_len;
 } SubsetOpData;
 
 static
@@ -148,32 +173,68 @@ gpointer subset_op_create_data(BOperation * op, gpointer data, BData * input)
   if (input == NULL)
     return NULL;
   SubsetOpData *d;
-  gboolean neu = TRUE;
   if (data == NULL) {
     d = g_new0(SubsetOpData, 1);
   } else {
-    neu = FALSE;
     d = (SubsetOpData *) data;
   }
   BSubsetOperation *sop = B_SUBSET_OPERATION(op);
   d->sop = *sop;
+  unsigned int dims[2];
+  unsigned int i, j, len;
   if (B_IS_VECTOR(input)) {
-    BVector *vec = B_VECTOR(input);
-    d->input =
-      b_create_input_array_from_vector(vec, neu, d->size.rows, d->input);
-    if (d->output_size.columns != sop->length1) {
-      d->output = g_new(double, sop->length1);
+    subset_size(op, input, dims);
+    d->output_size.rows = 0;
+    d->output_size.columns = dims[0];
+    len = dims[0];
+  } else {
+    subset_size(op, input, dims);
+    d->output_size.rows = dims[0];
+    d->output_size.columns = dims[1];
+    len = dims[0] * dims[1];
+  }
+  if (d->output_len != len || d->output == NULL) {
+    g_clear_pointer(&d->output,g_free);
+    d->output = g_try_new0(double, MAX(len, 1));
+    d->output_len = d->output ? len : 0;
+  }
+  if (d->output_len == 0)
+    return d;
+
+  double *v = d->output;
+  unsigned int ncol = d->output_size.columns;
+  if (B_IS_H5_VECTOR(input)) {
+    b_h5_vector_get_range(B_H5_VECTOR(input), sop->start1, sop->step1, len, v);
+    return d;
+  }
+  if (B_IS_H5_MATRIX(input)) {
+    b_h5_matrix_get_region(B_H5_MATRIX(input), sop->start2, sop->start1,
+                           sop->step2, sop->step1, d->output_size, v);
+    return d;
+  }
+  if (B_IS_VECTOR(input)) {
+    const double *x = b_vector_get_values(B_VECTOR(input)) + sop->start1;
+    if (sop->step1 == 1) {
+      memcpy(v, x, len * sizeof(double));
+    } else {
+      for (j = 0; j < ncol; j++)
+        v[j] = x[(size_t) j * sop->step1];
     }
     return d;
   }
   BMatrix *mat = B_MATRIX(input);
-  d->input = b_create_input_array_from_matrix(mat, neu, d->size, d->input);
-  d->size = b_matrix_get_size(mat);
-  unsigned int dims[2];
-  subset_size(op, input, dims);
-  if (d->output_size.columns != dims[0] || d->output_size.rows != dims[1]) {
-    g_free(d->output);
-    d->output = g_new(double, dims[0] * dims[1]);
+  unsigned int in_ncol = b_matrix_get_columns(mat);
+  const double *m = b_matrix_get_values(mat);
+  for (i = 0; i < d->output_size.rows; i++) {
+    const double *x = m + (size_t) (sop->start2 + i * sop->step2) * in_ncol
+      + sop->start1;
+    double *o = v + (size_t) i * ncol;
+    if (sop->step1 == 1) {
+      memcpy(o, x, ncol * sizeof(double));
+    } else {
+      for (j = 0; j < ncol; j++)
+        o[j] = x[(size_t) j * sop->step1];
+    }
   }
   return d;
 }
@@ -182,7 +243,6 @@ static
 void subset_op_data_free(gpointer d)
 {
   SubsetOpData *s = (SubsetOpData *) d;
-  g_free(s->input);
   g_free(s->output);
   g_free(d);
 }
@@ -195,25 +255,7 @@ gpointer subset_op(gpointer input)
   if (d == NULL)
     return NULL;
 
-  unsigned int ncol = d->size.columns;
-  double *m = d->input;
-
-  double *v = d->output;
-  unsigned int i, j;
-
-  if (d->size.rows==0) {
-    for (j = 0; j < d->sop.length1; j++) {
-      v[j] = m[j + d->sop.start1];
-    }
-  } else {
-    for (j = 0; j < d->sop.length1; j++) {
-      for (i = 0; i < d->sop.length2; i++) {
-        v[i * d->sop.length1 + j] =
-          m[(i + d->sop.start2) * ncol + j + d->sop.start1];
-      }
-    }
-  }
-  return v;
+  return d->output;
 }
 
 static void b_subset_operation_class_init(BSubsetOperationClass * subset_klass)
@@ -248,6 +290,18 @@ static void b_subset_operation_class_init(BSubsetOperationClass * subset_klass)
        g_param_spec_int("length2", "Length #2",
                         "Second length", 1, 2000000000, 1,
                         G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, SUBSET_PROP_STEP1,
+       g_param_spec_int("step1", "Step #1",
+                        "Spacing of elements taken along the first index",
+                        1, 2000000000, 1,
+                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(gobject_klass, SUBSET_PROP_STEP2,
+       g_param_spec_int("step2", "Step #2",
+                        "Spacing of elements taken along the second index",
+                        1, 2000000000, 1,
+                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void b_subset_operation_init(BSubsetOperation * slice)
@@ -256,4 +310,6 @@ static void b_subset_operation_init(BSubsetOperation * slice)
   slice->length1 = 1;
   slice->start2 = 0;
   slice->length2 = 1;
+  slice->step1 = 1;
+  slice->step2 = 1;
 }
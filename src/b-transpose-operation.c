@@ -0,0 +1,308 @@
+/*
+ * b-transpose-operation.c :
+ *
+ * Copyright (C) 2017 Scott O. Johnson (scojo202@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <memory.h>
+#include <math.h>
+#include "b-transpose-operation.h"
+
+/**
+ * SECTION: b-transpose-operation
+ * @short_description: Operation that transposes, rotates or flips a matrix.
+ *
+ * This operation reorients a matrix: it can transpose it, rotate it
+ * clockwise by 90, 180 or 270 degrees, or flip it upside down (reversing
+ * the order of rows) or left to right. Putting data from a rotated camera
+ * into the orientation the rest of a pipeline expects keeps later column
+ * slices contiguous.
+ *
+ * Transposing and 90 degree rotations read the input in square tiles, so
+ * that both input and output stay in cache; large matrices are split
+ * between threads.
+ */
+
+enum {
+  TRANSPOSE_PROP_0,
+  TRANSPOSE_PROP_TYPE
+};
+
+/* side of the square tiles, in elements; 32x32 doubles is 8 kB */
+#define TRANSPOSE_TILE 32
+
+/* smallest number of elements worth reorienting on a separate thread */
+#define TRANSPOSE_MIN_JOB_SAMPLES 262144
+
+struct _BTransposeOperation {
+  BOperation base;
+  int type;
+};
+
+G_DEFINE_TYPE(BTransposeOperation, b_transpose_operation, B_TYPE_OPERATION);
+
+static void
+transpose_operation_set_property(GObject * gobject, guint param_id,
+                                 GValue const *value, GParamSpec * pspec)
+{
+  BTransposeOperation *sop = B_TRANSPOSE_OPERATION(gobject);
+
+  switch (param_id) {
+  case TRANSPOSE_PROP_TYPE:
+    sop->type = g_value_get_int(value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
+    return;		/* NOTE : RETURN */
+  }
+}
+
+static void
+transpose_operation_get_property(GObject * gobject, guint param_id,
+                                 GValue * value, GParamSpec * pspec)
+{
+  BTransposeOperation *sop = B_TRANSPOSE_OPERATION(gobject);
+
+  switch (param_id) {
+  case TRANSPOSE_PROP_TYPE:
+    g_value_set_int(value, sop->type);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(gobject, param_id, pspec);
+    return;		/* NOTE : RETURN */
+  }
+}
+
+static
+gboolean transpose_swaps_axes(int type)
+{
+  return type == ORIENT_TRANSPOSE || type == ORIENT_ROTATE_90 ||
+    type == ORIENT_ROTATE_270;
+}
+
+static
+int transpose_size(BOperation * op, BData * input, unsigned int *dims)
+{
+  g_return_val_if_fail(B_IS_MATRIX(input),0);
+  g_assert(dims);
+  BTransposeOperation *sop = B_TRANSPOSE_OPERATION(op);
+  BMatrixSize size = b_matrix_get_size(B_MATRIX(input));
+  if (transpose_swaps_axes(sop->type)) {
+    dims[0] = size.columns;
+    dims[1] = size.rows;
+  } else {
+    dims[0] = size.rows;
+    dims[1] = size.columns;
+  }
+  return 2;
+}
+
+typedef struct {
+  BTransposeOperation sop;
+  double *input;
+  BMatrixSize size;
+  BMatrixSize output_size;
+  double *output;
+  unsigned int output_len;
+  /* output element (i,j) is input[base + i*si + j*sj] */
+  ptrdiff_t base, si, sj;
+  unsigned int n_jobs;
+} TransposeOpData;
+
+static
+gpointer transpose_op_create_data(BOperation * op, gpointer data,
+                                  BData * input)
+{
+  if (input == NULL)
+    return NULL;
+  TransposeOpData *d;
+  gboolean neu = TRUE;
+  if (data == NULL) {
+    d = g_new0(TransposeOpData, 1);
+  } else {
+    d = (TransposeOpData *) data;
+    neu = (d->input == NULL);
+  }
+  BTransposeOperation *sop = B_TRANSPOSE_OPERATION(op);
+  d->sop = *sop;
+  BMatrix *mat = B_MATRIX(input);
+  d->input = b_create_input_array_from_matrix(mat, neu, d->size, d->input);
+  d->size = b_matrix_get_size(mat);
+  if (d->input == NULL) {
+    d->size.rows = 0;
+    d->size.columns = 0;
+  }
+
+  ptrdiff_t nrow = d->size.rows, ncol = d->size.columns;
+  switch (sop->type) {
+  case ORIENT_TRANSPOSE:
+    d->base = 0;
+    d->si = 1;
+    d->sj = ncol;
+    break;
+  case ORIENT_ROTATE_90:	/* clockwise */
+    d->base = (nrow - 1) * ncol;
+    d->si = 1;
+    d->sj = -ncol;
+    break;
+  case ORIENT_ROTATE_180:
+    d->base = nrow * ncol - 1;
+    d->si = -ncol;
+    d->sj = -1;
+    break;
+  case ORIENT_ROTATE_270:
+    d->base = ncol - 1;
+    d->si = -1;
+    d->sj = ncol;
+    break;
+  case ORIENT_FLIP_UD:
+    d->base = (nrow - 1) * ncol;
+    d->si = -ncol;
+    d->sj = 1;
+    break;
+  case ORIENT_FLIP_LR:
+  default:
+    d->base = ncol - 1;
+    d->si = ncol;
+    d->sj = -1;
+    break;
+  }
+  if (transpose_swaps_axes(sop->type)) {
+    d->output_size.rows = d->size.columns;
+    d->output_size.columns = d->size.rows;
+  } else {
+    d->output_size = d->size;
+  }
+
+  unsigned int len = d->size.rows * d->size.columns;
+  if (d->output_len != len || d->output == NULL) {
+    g_clear_pointer(&d->output,g_free);
+    d->output = g_try_new(double, MAX(len, 1));
+    d->output_len = d->output ? len : 0;
+  }
+  d->n_jobs = b_operation_get_n_jobs(len, TRANSPOSE_MIN_JOB_SAMPLES);
+  return d;
+}
+
+static
+void transpose_op_data_free(gpointer data)
+{
+  TransposeOpData *d = (TransposeOpData *) data;
+  g_clear_pointer(&d->input,g_free);
+  g_clear_pointer(&d->output,g_free);
+  g_free(d);
+}
+
+static
+void transpose_job(unsigned int job, gpointer data)
+{
+  TransposeOpData *d = (TransposeOpData *) data;
+  unsigned int nrow = d->output_size.rows;
+  unsigned int ncol = d->output_size.columns;
+  /* jobs get whole bands of tiles */
+  unsigned int n_tiles = (nrow + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+  unsigned int first = (unsigned int) (((size_t) n_tiles * job) / d->n_jobs);
+  unsigned int last = (unsigned int) (((size_t) n_tiles * (job + 1)) / d->n_jobs);
+  const double *in = d->input;
+  double *out = d->output;
+  unsigned int i, j, ib, jb;
+
+  for (ib = first * TRANSPOSE_TILE; ib < MIN(last * TRANSPOSE_TILE, nrow);
+       ib += TRANSPOSE_TILE) {
+    unsigned int iend = MIN(ib + TRANSPOSE_TILE, nrow);
+    if (d->sj == 1) {
+      /* rows stay rows: copy them whole */
+      for (i = ib; i < iend; i++)
+        memcpy(out + (size_t) i * ncol, in + d->base + (ptrdiff_t) i * d->si,
+               ncol * sizeof(double));
+      continue;
+    }
+    if (d->sj == -1) {
+      for (i = ib; i < iend; i++) {
+        const double *x = in + d->base + (ptrdiff_t) i * d->si;
+        double *o = out + (size_t) i * ncol;
+        for (j = 0; j < ncol; j++)
+          o[j] = x[-(ptrdiff_t) j];
+      }
+      continue;
+    }
+    for (jb = 0; jb < ncol; jb += TRANSPOSE_TILE) {
+      unsigned int jend = MIN(jb + TRANSPOSE_TILE, ncol);
+      for (i = ib; i < iend; i++) {
+        const double *x = in + d->base + (ptrdiff_t) i * d->si;
+        double *o = out + (size_t) i * ncol;
+        for (j = jb; j < jend; j++)
+          o[j] = x[(ptrdiff_t) j * d->sj];
+      }
+    }
+  }
+}
+
+static
+gpointer transpose_op(gpointer data)
+{
+  TransposeOpData *d = (TransposeOpData *) data;
+
+  if (d == NULL || d->output == NULL)
+    return NULL;
+  if (d->output_len == 0)
+    return d->output;
+
+  b_operation_run_parallel(d->n_jobs, transpose_job, d);
+  return d->output;
+}
+
+static void
+b_transpose_operation_class_init(BTransposeOperationClass * klass)
+{
+  GObjectClass *gobject_klass = (GObjectClass *) klass;
+  gobject_klass->set_property = transpose_operation_set_property;
+  gobject_klass->get_property = transpose_operation_get_property;
+  BOperationClass *op_klass = (BOperationClass *) klass;
+  op_klass->thread_safe = TRUE;
+  op_klass->op_size = transpose_size;
+  op_klass->op_func = transpose_op;
+  op_klass->op_data = transpose_op_create_data;
+  op_klass->op_data_free = transpose_op_data_free;
+
+  g_object_class_install_property(gobject_klass, TRANSPOSE_PROP_TYPE,
+      g_param_spec_int("type", "Type", "How to reorient the matrix",
+                       ORIENT_TRANSPOSE, ORIENT_FLIP_LR, ORIENT_TRANSPOSE,
+                       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void b_transpose_operation_init(BTransposeOperation * op)
+{
+  op->type = ORIENT_TRANSPOSE;
+}
+
+/**
+ * b_transpose_operation_new:
+ * @type: how to reorient the matrix, e.g. ORIENT_ROTATE_90
+ *
+ * Create a new operation that transposes, rotates or flips a matrix.
+ *
+ * Returns: a #BOperation
+ **/
+BOperation *b_transpose_operation_new(int type)
+{
+  BOperation *o = g_object_new(B_TYPE_TRANSPOSE_OPERATION, "type", type,
+                               NULL);
+
+  return o;
+}
@@ -0,0 +1,44 @@
+/*
+ * b-transpose-operation.h :
+ *
+ * Copyright (C) 2017 Scott O. Johnson (scojo202@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <data/b-data-class.h>
+#include <b-operation.h>
+
+G_BEGIN_DECLS
+
+G_DECLARE_FINAL_TYPE(BTransposeOperation,b_transpose_operation,B,TRANSPOSE_OPERATION,BOperation)
+
+#define B_TYPE_TRANSPOSE_OPERATION  (b_transpose_operation_get_type ())
+
+enum {
+	ORIENT_TRANSPOSE = 0,
+	ORIENT_ROTATE_90,
+	ORIENT_ROTATE_180,
+	ORIENT_ROTATE_270,
+	ORIENT_FLIP_UD,
+	ORIENT_FLIP_LR
+};
+
+BOperation *b_transpose_operation_new (int type);
+
+G_END_DECLS
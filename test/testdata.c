@@ -75,6 +75,41 @@ test_derived_vector_FFT_mag(void)
   g_object_unref(v);
 }
 
+static void
+test_derived_vector_FFT_single(void)
+{
+  BOperation *op = b_fft_operation_new(FFT_MAG);
+  g_object_set(op,"single-precision",TRUE,NULL);
+  BData *input = b_val_vector_new_alloc(100);
+  double *d = b_val_vector_get_array(B_VAL_VECTOR(input));
+  for (int i=0;i<100;i++) {
+    d[i]=1.0;
+  }
+  BDerivedVector *v = B_DERIVED_VECTOR(b_derived_vector_new(B_DATA(input),op));
+  g_assert_cmpuint(100/2+1,==,b_vector_get_len(B_VECTOR(v)));
+  g_assert_cmpfloat_with_epsilon(100.0, b_vector_get_value(B_VECTOR(v),0), 1e-4);
+  g_assert_cmpfloat_with_epsilon(0.0, b_vector_get_value(B_VECTOR(v),2), 1e-4);
+  g_object_unref(v);
+}
+
+static void
+test_derived_matrix_FFT_components(void)
+{
+  BOperation *op = g_object_new(B_TYPE_FFT_OPERATION,"components",
+                                FFT_COMPONENT(FFT_MAG) | FFT_COMPONENT(FFT_POWER),NULL);
+  BData *input = b_val_vector_new_alloc(100);
+  double *d = b_val_vector_get_array(B_VAL_VECTOR(input));
+  for (int i=0;i<100;i++) {
+    d[i]=1.0;
+  }
+  BDerivedMatrix *v = B_DERIVED_MATRIX(b_derived_matrix_new(B_DATA(input),op));
+  g_assert_cmpuint(2,==,b_matrix_get_rows(B_MATRIX(v)));
+  g_assert_cmpuint(100/2+1,==,b_matrix_get_columns(B_MATRIX(v)));
+  g_assert_cmpfloat(100.0, ==, b_matrix_get_value(B_MATRIX(v),0,0));
+  g_assert_cmpfloat(10000.0, ==, b_matrix_get_value(B_MATRIX(v),1,0));
+  g_object_unref(v);
+}
+
 static void
 test_derived_vector_FFT_phase(void)
 {
@@ -90,6 +125,76 @@ test_derived_vector_FFT_phase(void)
   g_object_unref(v);
 }
 
+static void
+test_derived_matrix_spectrogram(void)
+{
+  BOperation *op = b_spectrogram_operation_new(20, 10, FFT_WINDOW_RECT);
+  BData *input = b_val_vector_new_alloc(100);
+  double *d = b_val_vector_get_array(B_VAL_VECTOR(input));
+  for (int i=0;i<100;i++) {
+    d[i]=1.0;
+  }
+  BDerivedMatrix *v = B_DERIVED_MATRIX(b_derived_matrix_new(B_DATA(input),op));
+  g_assert_cmpuint(9,==,b_matrix_get_rows(B_MATRIX(v)));
+  g_assert_cmpuint(20/2+1,==,b_matrix_get_columns(B_MATRIX(v)));
+  g_assert_cmpfloat(20.0, ==, b_matrix_get_value(B_MATRIX(v),8,0));
+  g_assert_cmpfloat_with_epsilon(0.0, b_matrix_get_value(B_MATRIX(v),8,2), 1e-12);
+  g_object_unref(v);
+}
+
+static void
+test_fft_stream(void)
+{
+  BFFTStream *s = B_FFT_STREAM(b_fft_stream_new(NULL, 10, 5));
+  double d[20];
+  for (int i=0;i<20;i++) {
+    d[i]=1.0;
+  }
+  b_fft_stream_push(s, d, 7);
+  g_assert_cmpuint(0,==,b_fft_stream_get_n_frames(s));
+  b_fft_stream_push(s, d, 13);
+  g_assert_cmpuint(3,==,b_fft_stream_get_n_frames(s));
+  g_assert_cmpuint(10/2+1,==,b_vector_get_len(B_VECTOR(s)));
+  g_assert_cmpfloat(10.0, ==, b_vector_get_value(B_VECTOR(s),0));
+  g_object_unref(s);
+
+  /* overlap is clamped so that every frame has a new sample */
+  g_test_expect_message(NULL, G_LOG_LEVEL_WARNING, "*overlap*");
+  s = g_object_new(B_TYPE_FFT_STREAM, "frame-length", 8, "overlap", 8, NULL);
+  g_test_assert_expected_messages();
+  b_fft_stream_push(s, d, 10);
+  g_assert_cmpuint(3,==,b_fft_stream_get_n_frames(s));
+  g_object_unref(s);
+
+  /* properties not given take their defaults */
+  s = g_object_new(B_TYPE_FFT_STREAM, NULL);
+  b_fft_stream_push(s, d, 20);
+  g_assert_cmpuint(0,==,b_fft_stream_get_n_frames(s));
+  g_object_unref(s);
+}
+
+static void
+test_derived_vector_convolution(void)
+{
+  BData *kernel = b_val_vector_new_alloc(3);
+  double *k = b_val_vector_get_array(B_VAL_VECTOR(kernel));
+  for (int i=0;i<3;i++) {
+    k[i]=1.0;
+  }
+  BOperation *op = b_convolution_operation_new(CONV_CONVOLVE, B_VECTOR(kernel));
+  BData *input = b_val_vector_new_alloc(100);
+  double *d = b_val_vector_get_array(B_VAL_VECTOR(input));
+  for (int i=0;i<100;i++) {
+    d[i]=1.0;
+  }
+  BDerivedVector *v = B_DERIVED_VECTOR(b_derived_vector_new(B_DATA(input),op));
+  g_assert_cmpuint(102,==,b_vector_get_len(B_VECTOR(v)));
+  g_assert_cmpfloat_with_epsilon(1.0, b_vector_get_value(B_VECTOR(v),0), 1e-12);
+  g_assert_cmpfloat_with_epsilon(3.0, b_vector_get_value(B_VECTOR(v),50), 1e-12);
+  g_assert_cmpfloat_with_epsilon(1.0, b_vector_get_value(B_VECTOR(v),101), 1e-12);
+  g_object_unref(v);
+}
+
 static void
 test_derived_vector_slice(void)
 {
@@ -127,6 +232,107 @@ test_derived_vector_slice_null(void)
   g_object_unref(v);
 }
 
+static void
+test_derived_vector_slice_col(void)
+{
+  BOperation *op = b_slice_operation_new(SLICE_COL, 7, 1);
+  BData *m = b_val_matrix_new_alloc(50,20);
+  double *d = b_val_matrix_get_array(B_VAL_MATRIX(m));
+  for (int i=0;i<50*20;i++) {
+    d[i]=(double)i;
+  }
+  BDerivedVector *v = B_DERIVED_VECTOR(b_derived_vector_new(B_DATA(m),op));
+  g_assert_cmpuint(50,==,b_vector_get_len(B_VECTOR(v)));
+  g_assert_cmpfloat(30*20+7, ==, b_vector_get_value(B_VECTOR(v),30));
+  g_object_set(op,"index",19,NULL);
+  g_assert_cmpfloat(30*20+19, ==, b_vector_get_value(B_VECTOR(v),30));
+  g_object_unref(v);
+}
+
+static void
+test_derived_vector_slice_sums(void)
+{
+  BOperation *op = b_slice_operation_new(SLICE_SUMROWS, 0, -1);
+  g_object_set(op,"mean",TRUE,NULL);
+  BData *m = b_val_matrix_new_alloc(101,100);
+  double *d = b_val_matrix_get_array(B_VAL_MATRIX(m));
+  for (int i=0;i<101*100;i++) {
+    d[i]=(double)i;
+  }
+  BDerivedVector *v = B_DERIVED_VECTOR(b_derived_vector_new(B_DATA(m),op));
+  g_assert_cmpuint(100,==,b_vector_get_len(B_VECTOR(v)));
+  g_assert_cmpfloat_with_epsilon(5000.0+7, b_vector_get_value(B_VECTOR(v),7), 1e-9);
+  g_object_set(op,"type",SLICE_SUMCOLS,"index",50,"width",10,"mean",FALSE,NULL);
+  g_assert_cmpuint(101,==,b_vector_get_len(B_VECTOR(v)));
+  g_assert_cmpfloat_with_epsilon(11*3*100.0+550.0, b_vector_get_value(B_VECTOR(v),3), 1e-9);
+  g_object_unref(v);
+}
+
+static void
+test_derived_vector_slice_sums_large(void)
+{
+  BOperation *op = b_slice_operation_new(SLICE_SUMROWS, 0, -1);
+  BData *m = b_val_matrix_new_alloc(1024,1000);
+  double *d = b_val_matrix_get_array(B_VAL_MATRIX(m));
+  for (int i=0;i<1024;i++) {
+    for (int j=0;j<1000;j++) {
+      d[i*1000+j]=(double)(i+j);
+    }
+  }
+  BDerivedVector *v = B_DERIVED_VECTOR(b_derived_vector_new(B_DATA(m),op));
+  g_assert_cmpuint(1000,==,b_vector_get_len(B_VECTOR(v)));
+  g_assert_cmpfloat(1023.0*512+1024*5, ==, b_vector_get_value(B_VECTOR(v),5));
+  g_object_set(op,"type",SLICE_SUMCOLS,NULL);
+  g_assert_cmpuint(1024,==,b_vector_get_len(B_VECTOR(v)));
+  g_assert_cmpfloat(999.0*500+1000*700, ==, b_vector_get_value(B_VECTOR(v),700));
+  g_object_unref(v);
+}
+
+static void
+test_derived_vector_slice_integral(void)
+{
+  BOperation *op = b_slice_operation_new(SLICE_SUMROWS, 10, 4);
+  g_object_set(op,"integral",TRUE,NULL);
+  BData *m = b_val_matrix_new_alloc(40,30);
+  double *d = b_val_matrix_get_array(B_VAL_MATRIX(m));
+  for (int i=0;i<40*30;i++) {
+    d[i]=(double)i;
+  }
+  BDerivedVector *v = B_DERIVED_VECTOR(b_derived_vector_new(B_DATA(m),op));
+  /* rows 8 to 12 */
+  g_assert_cmpfloat_with_epsilon(5*3.0+30.0*(8+9+10+11+12), b_vector_get_value(B_VECTOR(v),3), 1e-9);
+  g_object_set(op,"index",20,"width",0,NULL);
+  g_assert_cmpfloat_with_epsilon(20*30.0+3, b_vector_get_value(B_VECTOR(v),3), 1e-9);
+  g_object_set(op,"type",SLICE_SUMCOLS,"index",5,"width",2,"mean",TRUE,NULL);
+  g_assert_cmpuint(40,==,b_vector_get_len(B_VECTOR(v)));
+  g_assert_cmpfloat_with_epsilon(7*30.0+5, b_vector_get_value(B_VECTOR(v),7), 1e-9);
+  d[7*30+5]=0.0;
+  b_data_emit_changed(m);
+  g_assert_cmpfloat_with_epsilon((7*30.0*2+4+6)/3, b_vector_get_value(B_VECTOR(v),7), 1e-9);
+  g_object_unref(v);
+}
+
+static void
+test_derived_vector_line_profile(void)
+{
+  BOperation *op = b_line_profile_operation_new(2.0, 3.0, 12.0, 13.0, 3);
+  g_object_set(op,"n-samples",21,"interpolation",PROFILE_BILINEAR,NULL);
+  BData *m = b_val_matrix_new_alloc(30,20);
+  double *d = b_val_matrix_get_array(B_VAL_MATRIX(m));
+  for (int i=0;i<30;i++) {
+    for (int j=0;j<20;j++) {
+      d[i*20+j]=j+100.0*i;
+    }
+  }
+  BDerivedVector *v = B_DERIVED_VECTOR(b_derived_vector_new(B_DATA(m),op));
+  g_assert_cmpuint(21,==,b_vector_get_len(B_VECTOR(v)));
+  g_assert_cmpfloat_with_epsilon(352.5, b_vector_get_value(B_VECTOR(v),1), 1e-9);
+  g_assert_cmpfloat_with_epsilon(807.0, b_vector_get_value(B_VECTOR(v),10), 1e-9);
+  g_object_set(op,"interpolation",PROFILE_NEAREST,"width",1,NULL);
+  g_assert_cmpfloat(807.0, ==, b_vector_get_value(B_VECTOR(v),10));
+  g_object_unref(v);
+}
+
 static void
 test_derived_vector_subset(void)
 {
@@ -142,6 +348,102 @@ test_derived_vector_subset(void)
   g_object_unref(v);
 }
 
+static void
+test_derived_matrix_subset_step(void)
+{
+  BOperation *op = g_object_new(B_TYPE_SUBSET_OPERATION,"start1",1,"length1",10,"step1",4,
+                                "start2",2,"length2",100,"step2",10,NULL);
+  BData *input = b_val_matrix_new_alloc(50,20);
+  double *d = b_val_matrix_get_array(B_VAL_MATRIX(input));
+  for (int i=0;i<50*20;i++) {
+    d[i]=(double)i;
+  }
+  BDerivedMatrix *v = B_DERIVED_MATRIX(b_derived_matrix_new(B_DATA(input),op));
+  g_assert_cmpuint(5,==,b_matrix_get_rows(B_MATRIX(v)));
+  g_assert_cmpuint(3,==,b_matrix_get_columns(B_MATRIX(v)));
+  g_assert_cmpfloat(32*20+9, ==, b_matrix_get_value(B_MATRIX(v),3,2));
+  g_object_unref(v);
+}
+
+static void
+test_derived_matrix_bin(void)
+{
+  BOperation *op = b_bin_operation_new(2, 2, FALSE);
+  BData *input = b_val_matrix_new_alloc(9,8);
+  double *d = b_val_matrix_get_array(B_VAL_MATRIX(input));
+  for (int i=0;i<9*8;i++) {
+    d[i]=(double)i;
+  }
+  BDerivedMatrix *v = B_DERIVED_MATRIX(b_derived_matrix_new(B_DATA(input),op));
+  g_assert_cmpuint(4,==,b_matrix_get_rows(B_MATRIX(v)));
+  g_assert_cmpuint(4,==,b_matrix_get_columns(B_MATRIX(v)));
+  /* rows 2-3, columns 4-5 */
+  g_assert_cmpfloat(16+4+16+5+24+4+24+5, ==, b_matrix_get_value(B_MATRIX(v),1,2));
+  g_object_set(op,"bin1",4,"bin2",3,"mean",TRUE,NULL);
+  g_assert_cmpuint(3,==,b_matrix_get_rows(B_MATRIX(v)));
+  g_assert_cmpuint(2,==,b_matrix_get_columns(B_MATRIX(v)));
+  /* rows 3-5, columns 4-7 */
+  g_assert_cmpfloat_with_epsilon(4*8+5.5, b_matrix_get_value(B_MATRIX(v),1,1), 1e-12);
+  g_object_unref(v);
+}
+
+static void
+test_derived_matrix_regions(void)
+{
+  BRegionOperation *op = B_REGION_OPERATION(b_region_operation_new());
+  BData *input = b_val_matrix_new_alloc(20,20);
+  double *d = b_val_matrix_get_array(B_VAL_MATRIX(input));
+  for (int i=0;i<20*20;i++) {
+    d[i]=(double)i;
+  }
+  double x[3] = {0.0, 10.0, 0.0};
+  double y[3] = {0.0, 0.0, 10.0};
+  b_region_operation_add_rectangle(op, 2.0, 3.0, 5.0, 6.0);
+  BDerivedMatrix *v = B_DERIVED_MATRIX(b_derived_matrix_new(B_DATA(input),B_OPERATION(op)));
+  g_assert_cmpuint(1,==,b_matrix_get_rows(B_MATRIX(v)));
+  b_region_operation_add_ellipse(op, 10.0, 10.0, 2.0, 2.0);
+  b_region_operation_add_polygon(op, x, y, 3);
+  g_assert_cmpuint(3,==,b_matrix_get_rows(B_MATRIX(v)));
+  g_assert_cmpuint(REGION_N_STATS,==,b_matrix_get_columns(B_MATRIX(v)));
+  g_assert_cmpfloat(16.0, ==, b_matrix_get_value(B_MATRIX(v),0,REGION_COUNT));
+  g_assert_cmpfloat(1496.0, ==, b_matrix_get_value(B_MATRIX(v),0,REGION_SUM));
+  g_assert_cmpfloat(62.0, ==, b_matrix_get_value(B_MATRIX(v),0,REGION_MIN));
+  g_assert_cmpfloat(125.0, ==, b_matrix_get_value(B_MATRIX(v),0,REGION_MAX));
+  g_assert_cmpfloat(13.0, ==, b_matrix_get_value(B_MATRIX(v),1,REGION_COUNT));
+  g_assert_cmpfloat(210.0, ==, b_matrix_get_value(B_MATRIX(v),1,REGION_MEAN));
+  g_assert_cmpfloat(65.0, ==, b_matrix_get_value(B_MATRIX(v),2,REGION_COUNT));
+  g_object_unref(v);
+}
+
+static void
+test_derived_matrix_transpose(void)
+{
+  BData *input = b_val_matrix_new_alloc(40,50);
+  double *d = b_val_matrix_get_array(B_VAL_MATRIX(input));
+  for (int i=0;i<40*50;i++) {
+    d[i]=(double)i;
+  }
+  BOperation *op = b_transpose_operation_new(ORIENT_TRANSPOSE);
+  BDerivedMatrix *v = B_DERIVED_MATRIX(b_derived_matrix_new(B_DATA(input),op));
+  g_assert_cmpuint(50,==,b_matrix_get_rows(B_MATRIX(v)));
+  g_assert_cmpuint(40,==,b_matrix_get_columns(B_MATRIX(v)));
+  g_assert_cmpfloat(50.0*35+37, ==, b_matrix_get_value(B_MATRIX(v),37,35));
+  g_object_set(op,"type",ORIENT_ROTATE_90,NULL);
+  g_assert_cmpfloat(50.0*39, ==, b_matrix_get_value(B_MATRIX(v),0,0));
+  g_assert_cmpfloat(50.0*4+33, ==, b_matrix_get_value(B_MATRIX(v),33,35));
+  g_object_set(op,"type",ORIENT_ROTATE_270,NULL);
+  g_assert_cmpfloat(49.0, ==, b_matrix_get_value(B_MATRIX(v),0,0));
+  g_assert_cmpfloat(50.0*35+16, ==, b_matrix_get_value(B_MATRIX(v),33,35));
+  g_object_set(op,"type",ORIENT_ROTATE_180,NULL);
+  g_assert_cmpuint(40,==,b_matrix_get_rows(B_MATRIX(v)));
+  g_assert_cmpfloat(50.0*40-1, ==, b_matrix_get_value(B_MATRIX(v),0,0));
+  g_object_set(op,"type",ORIENT_FLIP_UD,NULL);
+  g_assert_cmpfloat(50.0*38+3, ==, b_matrix_get_value(B_MATRIX(v),1,3));
+  g_object_set(op,"type",ORIENT_FLIP_LR,NULL);
+  g_assert_cmpfloat(50.0+46, ==, b_matrix_get_value(B_MATRIX(v),1,3));
+  g_object_unref(v);
+}
+
 static void
 test_derived_matrix_simple(void)
 {
@@ -165,6 +467,56 @@ test_derived_matrix_simple(void)
   g_object_unref(v);
 }
 
+static void
+test_derived_matrix_multi_slice(void)
+{
+  BOperation *op = b_multi_slice_operation_new(SLICE_SUMROWS, 10, 20, 3, 2);
+  BData *m = b_val_matrix_new_alloc(60,30);
+  double *d = b_val_matrix_get_array(B_VAL_MATRIX(m));
+  for (int i=0;i<60*30;i++) {
+    d[i]=(double)i;
+  }
+  BDerivedMatrix *v = B_DERIVED_MATRIX(b_derived_matrix_new(B_DATA(m),op));
+  g_assert_cmpuint(3,==,b_matrix_get_rows(B_MATRIX(v)));
+  g_assert_cmpuint(30,==,b_matrix_get_columns(B_MATRIX(v)));
+  /* rows 29 to 31 */
+  g_assert_cmpfloat(30.0*(29+30+31)+3*4, ==, b_matrix_get_value(B_MATRIX(v),1,4));
+  int cols[2] = {25, 2};
+  g_object_set(op,"type",SLICE_COL,NULL);
+  b_multi_slice_operation_set_indices(B_MULTI_SLICE_OPERATION(op),cols,2);
+  g_assert_cmpuint(2,==,b_matrix_get_rows(B_MATRIX(v)));
+  g_assert_cmpuint(60,==,b_matrix_get_columns(B_MATRIX(v)));
+  g_assert_cmpfloat(7*30+25, ==, b_matrix_get_value(B_MATRIX(v),0,7));
+  g_assert_cmpfloat(7*30+2, ==, b_matrix_get_value(B_MATRIX(v),1,7));
+  g_object_unref(v);
+}
+
+static void
+test_stats_struct(void)
+{
+  BData *m = b_val_matrix_new_alloc(4,3);
+  double *d = b_val_matrix_get_array(B_VAL_MATRIX(m));
+  for (int i=0;i<4*3;i++) {
+    d[i]=(double)i;
+  }
+  d[2*3+1]=100.0;
+  guint stats = STATS_COMPONENT(STATS_MAX) | STATS_COMPONENT(STATS_ARGMAX) |
+                STATS_COMPONENT(STATS_MEAN) | STATS_COMPONENT(STATS_STD);
+  BData *s = b_stats_struct_new(m, STATS_ROWS, stats);
+  BVector *max = B_VECTOR(b_struct_get_data(B_STRUCT(s),"max"));
+  BVector *argmax = B_VECTOR(b_struct_get_data(B_STRUCT(s),"argmax"));
+  BVector *mean = B_VECTOR(b_struct_get_data(B_STRUCT(s),"mean"));
+  BVector *std = B_VECTOR(b_struct_get_data(B_STRUCT(s),"std"));
+  g_assert_cmpuint(3,==,b_vector_get_len(max));
+  g_assert_cmpfloat(100.0, ==, b_vector_get_value(max,1));
+  g_assert_cmpfloat(2.0, ==, b_vector_get_value(argmax,1));
+  g_assert_cmpfloat(11.0, ==, b_vector_get_value(max,2));
+  g_assert_cmpfloat(3.0, ==, b_vector_get_value(argmax,2));
+  g_assert_cmpfloat_with_epsilon(4.5, b_vector_get_value(mean,0), 1e-12);
+  g_assert_cmpfloat_with_epsilon(sqrt(11.25), b_vector_get_value(std,0), 1e-12);
+  g_object_unref(s);
+}
+
 static void
 test_derived_matrix_subset(void)
 {
@@ -195,11 +547,28 @@ main (int argc, char *argv[])
   g_test_add_func("/BData/derived/vector/subset",test_derived_vector_subset);
   g_test_add_func("/BData/derived/vector/FFT/mag",test_derived_vector_FFT_mag);
   g_test_add_func("/BData/derived/vector/FFT/phase",test_derived_vector_FFT_phase);
+  g_test_add_func("/BData/derived/vector/FFT/single",test_derived_vector_FFT_single);
+  g_test_add_func("/BData/FFT/stream",test_fft_stream);
+  g_test_add_func("/BData/derived/vector/convolution",test_derived_vector_convolution);
   g_test_add_func("/BData/derived/vector/slice",test_derived_vector_slice);
   g_test_add_func("/BData/derived/vector/slice/null",test_derived_vector_slice_null);
+  g_test_add_func("/BData/derived/vector/slice/col",test_derived_vector_slice_col);
+  g_test_add_func("/BData/derived/vector/slice/sums",test_derived_vector_slice_sums);
+  g_test_add_func("/BData/derived/vector/slice/sums/large",test_derived_vector_slice_sums_large);
+  g_test_add_func("/BData/derived/vector/slice/integral",test_derived_vector_slice_integral);
+  g_test_add_func("/BData/derived/vector/lineprofile",test_derived_vector_line_profile);
   g_test_add_func("/BData/derived/matrix/simple",test_derived_matrix_simple);
   g_test_add_func("/BData/derived/matrix/subset",test_derived_matrix_subset);
+  g_test_add_func("/BData/derived/matrix/subset/step",test_derived_matrix_subset_step);
+  g_test_add_func("/BData/derived/matrix/bin",test_derived_matrix_bin);
+  g_test_add_func("/BData/derived/matrix/regions",test_derived_matrix_regions);
+  g_test_add_func("/BData/derived/matrix/transpose",test_derived_matrix_transpose);
+  g_test_add_func("/BData/derived/matrix/multislice",test_derived_matrix_multi_slice);
+  g_test_add_func("/BData/derived/struct/stats",test_stats_struct);
+  g_test_add_func("/BData/derived/matrix/FFT/components",test_derived_matrix_FFT_components);
+  g_test_add_func("/BData/derived/matrix/spectrogram",test_derived_matrix_spectrogram);
   int retval = g_test_run();
   fftw_cleanup();
+  fftwf_cleanup();
   return retval;
 }
@@ -1,4 +1,5 @@
 #include <math.h>
+#include <string.h>
 #include <b-data.h>
 #include <b-extras.h>
 
@@ -74,9 +75,35 @@ void on_subdata_changed(BStruct *s, BData *d, gpointer user_data)
   g_message("x: %p %p %p",s,d,user_data);
 }
 
+/* run in a separate process by the SWMR test, so the file isn't shared
+ * with the writer inside libhdf5 */
+static
+int follow_swmr(void)
+{
+  BFile *f = b_file_open_for_reading_swmr("test-swmr.h5", NULL);
+  if (f == NULL)
+    return 1;
+  BData *m = b_h5_matrix_new(f, "trace", NULL);
+  if (m == NULL)
+    return 1;
+  unsigned int rows = b_matrix_get_rows(B_MATRIX(m));
+  for (int i=0; i<100 && rows < 8; i++) {
+    g_usleep(50000);
+    rows += b_h5_matrix_refresh(B_H5_MATRIX(m));
+  }
+  int r = (rows == 8 && b_matrix_get_rows(B_MATRIX(m)) == 8 &&
+           b_matrix_get_value(B_MATRIX(m), 7, 50) == 7.0) ? 0 : 1;
+  g_object_unref(m);
+  g_object_unref(f);
+  return r;
+}
+
 int
 main (int argc, char *argv[])
 {
+  if (argc > 1 && strcmp(argv[1], "--follow-swmr") == 0)
+    return follow_swmr();
+
   BStruct *s = g_object_new(B_TYPE_STRUCT,NULL);
 
   g_signal_connect(s, "subdata-changed",
@@ -127,5 +154,203 @@ main (int argc, char *argv[])
   }
   //g_object_unref(s);
 
+  /* test streaming frames */
+  hfile = b_file_open_for_writing("test-stream.h5", TRUE, NULL);
+  hsize_t frame_dims[2] = {40, 30};
+  BFileStream *stream = b_file_stream_new(hfile, "frames", 2, frame_dims, NULL);
+  BData *frame = b_val_matrix_new_alloc(40, 30);
+  double *fd = b_val_matrix_get_array(B_VAL_MATRIX(frame));
+  for (int k=0; k<250; k++) {
+    for (int i=0; i<40*30; i++)
+      fd[i] = k+i;
+    b_file_stream_append(stream, frame, k*1000, NULL);
+  }
+  g_assert_cmpuint(250, ==, b_file_stream_get_n_records(stream));
+  g_object_unref(stream);
+  g_object_unref(frame);
+  g_object_unref(hfile);
+
+  hfile = b_file_open_for_reading("test-stream.h5", NULL);
+  BData *times = b_vector_from_h5(b_file_get_handle(hfile), "frames_timestamps");
+  g_assert_cmpuint(250, ==, b_vector_get_len(B_VECTOR(times)));
+  g_assert_cmpfloat(249000.0, ==, b_vector_get_value(B_VECTOR(times), 249));
+  g_object_unref(times);
+  /* frames of the stream, read on demand */
+  BData *fm = b_h5_matrix_new_frame(hfile, "frames", 100, NULL);
+  g_assert_cmpuint(250, ==, b_h5_matrix_get_n_frames(B_H5_MATRIX(fm)));
+  g_assert_cmpuint(40, ==, b_matrix_get_rows(B_MATRIX(fm)));
+  g_assert_cmpfloat(100+7*30+3, ==, b_matrix_get_value(B_MATRIX(fm), 7, 3));
+  b_h5_matrix_set_frame(B_H5_MATRIX(fm), 249);
+  g_assert_cmpfloat(249+39*30+29, ==, b_matrix_get_value(B_MATRIX(fm), 39, 29));
+  g_object_unref(fm);
+  g_object_unref(hfile);
+
+  /* test writing on a separate thread */
+  hfile = b_file_open_for_writing("test-writer.h5", TRUE, NULL);
+  hsize_t len = 100;
+  stream = b_file_stream_new(hfile, "vectors", 1, &len, NULL);
+  BFileWriter *writer = b_file_writer_new(hfile, 8, FALSE);
+  BData *vec = b_val_vector_new_alloc(100);
+  /* a stream written and closed here while the writer thread runs */
+  BFileStream *direct = b_file_stream_new(hfile, "direct", 1, &len, NULL);
+  for (int k=0; k<50; k++) {
+    b_val_vector_get_array(B_VAL_VECTOR(vec))[0] = k;
+    b_file_writer_append(writer, stream, vec, -1);
+    b_file_stream_append(direct, vec, -1, NULL);
+  }
+  g_object_unref(direct);
+  b_file_writer_attach_data(writer, "vector", vec);
+  g_assert_true(b_file_writer_sync(writer, NULL));
+  g_assert_cmpuint(51, ==, b_file_writer_get_n_written(writer));
+  g_assert_cmpuint(0, ==, b_file_writer_get_n_dropped(writer));
+  g_assert_cmpuint(50, ==, b_file_stream_get_n_records(stream));
+  g_object_unref(writer);
+  g_object_unref(stream);
+  g_object_unref(vec);
+  g_object_unref(hfile);
+  hfile = b_file_open_for_reading("test-writer.h5", NULL);
+  BData *vectors = b_matrix_from_h5(b_file_get_handle(hfile), "vectors");
+  g_assert_cmpuint(50, ==, b_matrix_get_rows(B_MATRIX(vectors)));
+  g_assert_cmpfloat(49.0, ==, b_matrix_get_value(B_MATRIX(vectors), 49, 0));
+  g_object_unref(vectors);
+  vectors = b_matrix_from_h5(b_file_get_handle(hfile), "direct");
+  g_assert_cmpuint(50, ==, b_matrix_get_rows(B_MATRIX(vectors)));
+  g_object_unref(vectors);
+  g_object_unref(hfile);
+
+  /* test storage options */
+  hfile = b_file_open_for_writing("test-storage.h5", TRUE, NULL);
+  BFileStorage storage;
+  b_file_storage_init(&storage);
+  storage.deflate = 1;
+  storage.fletcher32 = TRUE;
+  storage.chunk[0] = 1000;
+  storage.chunk[1] = 10;
+  b_file_set_storage(hfile, &storage);
+  b_file_attach_data(hfile, "chunked", d2);
+  storage.deflate = 0;
+  storage.shuffle = FALSE;
+  storage.fletcher32 = FALSE;
+  storage.chunk[0] = 0;
+  b_file_set_storage(hfile, &storage);
+  b_file_attach_data(hfile, "unfiltered", d2);
+  b_file_storage_init(&storage);
+  b_file_set_storage(hfile, &storage);
+  b_file_attach_data(hfile, "default", d2);
+  g_object_unref(hfile);
+  hfile = b_file_open_for_reading("test-storage.h5", NULL);
+  BData *m1 = b_matrix_from_h5(b_file_get_handle(hfile), "chunked");
+  BData *m2 = b_matrix_from_h5(b_file_get_handle(hfile), "unfiltered");
+  g_assert_cmpfloat(b_matrix_get_value(B_MATRIX(d2), 1234, 56), ==,
+                    b_matrix_get_value(B_MATRIX(m1), 1234, 56));
+  g_assert_cmpfloat(b_matrix_get_value(B_MATRIX(d2), 1234, 56), ==,
+                    b_matrix_get_value(B_MATRIX(m2), 1234, 56));
+  /* read with chunks inflated in parallel */
+  BData *m4 = b_matrix_from_h5(b_file_get_handle(hfile), "default");
+  g_assert_cmpfloat(b_matrix_get_value(B_MATRIX(d2), 19999, 99), ==,
+                    b_matrix_get_value(B_MATRIX(m4), 19999, 99));
+  g_object_unref(m1);
+  g_object_unref(m2);
+  g_object_unref(m4);
+
+  /* test reading parts of a dataset on demand */
+  BData *lazy = b_h5_matrix_new(hfile, "chunked", NULL);
+  g_assert_cmpuint(DATA_COUNT, ==, b_matrix_get_rows(B_MATRIX(lazy)));
+  b_h5_matrix_set_cache_size(B_H5_MATRIX(lazy), 1 << 20);
+  BData *col = b_derived_vector_new(lazy, b_slice_operation_new(SLICE_COL, 37, 1));
+  g_assert_cmpfloat(b_matrix_get_value(B_MATRIX(d2), 15000, 37), ==,
+                    b_vector_get_value(B_VECTOR(col), 15000));
+  BOperation *subop = g_object_new(B_TYPE_SUBSET_OPERATION,"start1",5,"length1",90,"step1",3,
+                                   "start2",1000,"length2",5000,"step2",7,NULL);
+  BData *sub = b_derived_matrix_new(lazy, subop);
+  g_assert_cmpfloat(b_matrix_get_value(B_MATRIX(d2), 1000+7*11, 5+3*13), ==,
+                    b_matrix_get_value(B_MATRIX(sub), 11, 13));
+  g_assert_cmpfloat(b_matrix_get_value(B_MATRIX(d2), 19999, 99), ==,
+                    b_matrix_get_value(B_MATRIX(lazy), 19999, 99));
+  g_object_unref(col);
+  g_object_unref(sub);
+  g_object_unref(lazy);
+
+  /* test mapping a contiguous dataset */
+  BData *mapped = b_file_map_matrix(hfile, "unfiltered", NULL);
+  g_assert_cmpfloat(b_matrix_get_value(B_MATRIX(d2), 1234, 56), ==,
+                    b_matrix_get_value(B_MATRIX(mapped), 1234, 56));
+  /* changes to the mapping are private and don't reach the file */
+  b_val_matrix_get_array(B_VAL_MATRIX(mapped))[0] = -1.0;
+  m2 = b_matrix_from_h5(b_file_get_handle(hfile), "unfiltered");
+  g_assert_cmpfloat(b_matrix_get_value(B_MATRIX(d2), 0, 0), ==,
+                    b_matrix_get_value(B_MATRIX(m2), 0, 0));
+  g_object_unref(m2);
+  BData *unmapped = b_file_map_matrix(hfile, "chunked", NULL);
+  g_assert_cmpfloat(b_matrix_get_value(B_MATRIX(d2), 1234, 56), ==,
+                    b_matrix_get_value(B_MATRIX(unmapped), 1234, 56));
+  g_object_unref(mapped);
+  g_object_unref(unmapped);
+  g_object_unref(hfile);
+
+  /* test images stored as integers */
+  hfile = b_file_open_for_writing("test-image.h5", TRUE, NULL);
+  BImage *im = b_image_new(2, 48, 64);
+  guint16 *pix = (guint16 *) im->data;
+  for (int i=0; i<48*64; i++)
+    pix[i] = i;
+  b_image_attach_h5(im, b_file_get_handle(hfile), "image", NULL);
+  BFileStream *frames = b_file_stream_new_image(hfile, "frames", 2, 48, 64, NULL);
+  for (int k=0; k<10; k++) {
+    im->timestamp = k*1000;
+    g_assert_true(b_file_stream_append_image(frames, im, NULL));
+  }
+  g_object_unref(frames);
+  g_object_unref(hfile);
+  hfile = b_file_open_for_reading("test-image.h5", NULL);
+  BImage *im2 = b_image_from_h5(b_file_get_handle(hfile), "image");
+  g_assert_cmpuint(2, ==, im2->bytes);
+  g_assert_cmpuint(47*64+5, ==, ((guint16 *) im2->data)[47*64+5]);
+  BData *m3 = b_matrix_from_h5(b_file_get_handle(hfile), "image");
+  g_assert_cmpfloat(47*64+5, ==, b_matrix_get_value(B_MATRIX(m3), 47, 5));
+  g_object_unref(m3);
+  /* frame timestamps are stored in microseconds, 0 meaning now */
+  BData *ft = b_vector_from_h5(b_file_get_handle(hfile), "frames_timestamps");
+  g_assert_cmpfloat(9.0, ==, b_vector_get_value(B_VECTOR(ft), 9));
+  g_assert_cmpfloat(0.0, <, b_vector_get_value(B_VECTOR(ft), 0));
+  g_object_unref(ft);
+  m3 = b_h5_matrix_new_frame(hfile, "frames", 9, NULL);
+  g_assert_cmpfloat(47*64+5, ==, b_matrix_get_value(B_MATRIX(m3), 47, 5));
+  g_assert_cmpfloat(64+1, ==, b_matrix_get_values(B_MATRIX(m3))[64+1]);
+  g_object_unref(m3);
+  b_image_free(im2);
+  b_image_free(im);
+  g_object_unref(hfile);
+
+  /* test following a file written in SWMR mode, from another process */
+  hfile = b_file_open_for_writing_swmr("test-swmr.h5", TRUE, NULL);
+  hsize_t trace_len = 100;
+  BFileStream *trace = b_file_stream_new(hfile, "trace", 1, &trace_len, NULL);
+  g_assert_true(b_file_start_swmr(hfile, 200, NULL));
+  BData *tv = b_val_vector_new_alloc(100);
+  double *tva = b_val_vector_get_array(B_VAL_VECTOR(tv));
+  for (int k=0; k<5; k++) {
+    for (int i=0; i<100; i++)
+      tva[i] = k;
+    b_file_stream_append(trace, tv, k, NULL);
+  }
+  g_assert_true(b_file_stream_flush(trace, NULL));
+  /* the last records are left to the writer's periodic flush */
+  writer = b_file_writer_new(hfile, 8, FALSE);
+  for (int k=5; k<8; k++) {
+    for (int i=0; i<100; i++)
+      tva[i] = k;
+    b_file_writer_append(writer, trace, tv, k);
+  }
+  gchar *child_argv[] = { argv[0], "--follow-swmr", NULL };
+  gint status;
+  g_assert_true(g_spawn_sync(NULL, child_argv, NULL, G_SPAWN_DEFAULT, NULL,
+                             NULL, NULL, NULL, &status, NULL));
+  g_assert_true(g_spawn_check_exit_status(status, NULL));
+  g_object_unref(writer);
+  g_object_unref(trace);
+  g_object_unref(tv);
+  g_object_unref(hfile);
+
   return 0;
 }